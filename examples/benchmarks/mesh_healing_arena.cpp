@@ -0,0 +1,179 @@
+/* ============================================================================
+   Copyright (c) 2011-2014, Institute for Microelectronics,
+                            Institute for Analysis and Scientific Computing,
+                            TU Wien.
+
+                            -----------------
+                ViennaMesh - The Vienna Meshing Framework
+                            -----------------
+
+                    http://viennamesh.sourceforge.net/
+
+   License:         MIT (X11), see file LICENSE in the base directory
+=============================================================================== */
+
+// Compares the mesh_healing algorithms with and without their scratch arena,
+// reporting the number of heap allocations and the best wall time of each.
+//
+// usage: mesh_healing_arena [marching_cubes_resolution] [resample_resolution] [rounds]
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "viennameshpp/core.hpp"
+#include "viennameshpp/timer.hpp"
+
+
+#if __cplusplus >= 201103L
+  #define BENCHMARK_THROW_BAD_ALLOC
+  #define BENCHMARK_NOTHROW noexcept
+#else
+  #define BENCHMARK_THROW_BAD_ALLOC throw(std::bad_alloc)
+  #define BENCHMARK_NOTHROW throw()
+#endif
+
+namespace
+{
+  unsigned long heap_allocation_count = 0;
+}
+
+// counts every allocation of the process, including those of the plugins
+void * operator new(std::size_t size) BENCHMARK_THROW_BAD_ALLOC
+{
+  ++heap_allocation_count;
+
+  void * memory = std::malloc(size ? size : 1);
+  if (!memory)
+    throw std::bad_alloc();
+  return memory;
+}
+
+void operator delete(void * memory) BENCHMARK_NOTHROW
+{
+  std::free(memory);
+}
+
+
+
+// unit cube of resolution^3 cubes, each split into 6 tetrahedra, the cells
+// with x < 0.5 are in region 0, the others in region 1
+void make_two_region_mesh(viennagrid::mesh & mesh, int resolution)
+{
+  typedef viennagrid::mesh                                    MeshType;
+  typedef viennagrid::result_of::element<MeshType>::type      VertexType;
+  typedef viennagrid::result_of::element<MeshType>::type      CellType;
+
+  int vertex_resolution = resolution+1;
+  std::vector<VertexType> vertices;
+  for (int z = 0; z != vertex_resolution; ++z)
+    for (int y = 0; y != vertex_resolution; ++y)
+      for (int x = 0; x != vertex_resolution; ++x)
+        vertices.push_back( viennagrid::make_vertex(mesh,
+          viennagrid::make_point( static_cast<double>(x)/resolution,
+                                  static_cast<double>(y)/resolution,
+                                  static_cast<double>(z)/resolution ) ) );
+
+  static const int kuhn_tetrahedra[6][4] = { {0,1,3,7}, {0,1,5,7}, {0,2,3,7},
+                                             {0,2,6,7}, {0,4,5,7}, {0,4,6,7} };
+
+  for (int z = 0; z != resolution; ++z)
+    for (int y = 0; y != resolution; ++y)
+      for (int x = 0; x != resolution; ++x)
+      {
+        VertexType cube[8];
+        for (int i = 0; i != 8; ++i)
+          cube[i] = vertices[ ((z+(i>>2&1))*vertex_resolution + (y+(i>>1&1)))*vertex_resolution + (x+(i&1)) ];
+
+        int region_id = (2*x < resolution) ? 0 : 1;
+        for (int t = 0; t != 6; ++t)
+        {
+          CellType cell = viennagrid::make_tetrahedron( mesh,
+            cube[kuhn_tetrahedra[t][0]], cube[kuhn_tetrahedra[t][1]],
+            cube[kuhn_tetrahedra[t][2]], cube[kuhn_tetrahedra[t][3]] );
+          viennagrid::add( mesh.get_or_create_region(region_id), cell );
+        }
+      }
+}
+
+
+// After an unmeasured warm-up run, each round runs the algorithm once with the
+// heap and once with the arena. The order alternates between rounds so neither
+// variant always profits from the caches warmed up by the other one.
+void benchmark(viennamesh::algorithm_handle & algorithm, std::string const & name, int rounds)
+{
+  unsigned long allocations[2] = { 0, 0 };
+  double times[2] = { 0, 0 };
+
+  algorithm.set_input( "use_scratch_arena", false );
+  algorithm.run();
+
+  for (int round = 0; round != rounds; ++round)
+  {
+    for (int i = 0; i != 2; ++i)
+    {
+      int use_arena = (round + i) % 2;
+      algorithm.set_input( "use_scratch_arena", use_arena == 1 );
+
+      viennautils::Timer timer;
+      heap_allocation_count = 0;
+      timer.start();
+
+      algorithm.run();
+
+      double time = timer.get();
+      times[use_arena] = (round == 0) ? time : std::min(times[use_arena], time);
+      allocations[use_arena] = heap_allocation_count;
+    }
+  }
+
+  for (int use_arena = 0; use_arena != 2; ++use_arena)
+    std::cout << name << (use_arena ? "  arena:" : "  heap: ")
+              << "  allocations = " << allocations[use_arena]
+              << "  time = " << times[use_arena] << "s" << std::endl;
+
+  // the arena run may also allocate more than the heap run
+  long saved = static_cast<long>(allocations[0]) - static_cast<long>(allocations[1]);
+  std::cout << name << "  saved " << saved << " allocations ("
+            << (allocations[0] ? 100.0*saved/allocations[0] : 0.0) << "%), speedup "
+            << times[0]/times[1] << std::endl;
+}
+
+
+int main(int argc, char ** argv)
+{
+  int marching_cubes_resolution = (argc > 1) ? std::atoi(argv[1]) : 8;
+  int resample_resolution = (argc > 2) ? std::atoi(argv[2]) : 4;
+  int rounds = (argc > 3) ? std::max(std::atoi(argv[3]), 1) : 3;
+
+  viennamesh::context_handle context;
+
+
+  viennamesh::data_handle<viennagrid_mesh> marching_cubes_mesh = context.make_data<viennagrid_mesh>();
+  make_two_region_mesh( marching_cubes_mesh(), marching_cubes_resolution );
+
+  double sample_size = 0.5 / marching_cubes_resolution;
+
+  viennamesh::algorithm_handle marching_cubes = context.make_algorithm("multi_material_marching_cubes");
+  marching_cubes.set_input( "mesh", marching_cubes_mesh );
+  marching_cubes.set_input( "size_add", 0 );
+  marching_cubes.set_input( "region_scale", 1.0 );
+  marching_cubes.set_input( "is_inside_tolerance", 1e-6 );
+  marching_cubes.set_input( "sample_size", viennagrid::make_point(sample_size, sample_size, sample_size) );
+  benchmark( marching_cubes, "multi_material_marching_cubes", rounds );
+
+
+  viennamesh::data_handle<viennagrid_mesh> resample_mesh = context.make_data<viennagrid_mesh>();
+  make_two_region_mesh( resample_mesh(), resample_resolution );
+
+  viennamesh::algorithm_handle resample = context.make_algorithm("volumetric_resample");
+  resample.set_input( "reference_mesh", resample_mesh );
+  resample.set_input( "base_mesh", resample_mesh );
+  resample.set_input( "sample_count", 8 );
+  benchmark( resample, "volumetric_resample", rounds );
+
+  return 0;
+}
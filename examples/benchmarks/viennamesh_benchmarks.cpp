@@ -0,0 +1,576 @@
+/* ============================================================================
+   Copyright (c) 2011-2014, Institute for Microelectronics,
+                            Institute for Analysis and Scientific Computing,
+                            TU Wien.
+
+                            -----------------
+                ViennaMesh - The Vienna Meshing Framework
+                            -----------------
+
+                    http://viennamesh.sourceforge.net/
+
+   License:         MIT (X11), see file LICENSE in the base directory
+=============================================================================== */
+
+// Times the core algorithms, the data conversions, the io readers and writers
+// and the pipeline overhead on deterministic synthetic meshes of several sizes:
+// structured cubes of tetrahedra, spheres of N triangles, random 2D PLCs and
+// point clouds. The results are written as JSON so that runs can be compared.
+// Benchmarks of algorithms which are not available, e.g. because their plugin
+// was not built, are skipped.
+//
+// usage: viennamesh_benchmarks [output.json] [repetitions] [size_count]
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "viennameshpp/core.hpp"
+#include "viennameshpp/algorithm_pipeline.hpp"
+#include "viennameshpp/parallel.hpp"
+#include "viennameshpp/timer.hpp"
+
+
+// linear congruential generator, identical sequences on every platform
+class random_generator
+{
+public:
+  explicit random_generator(unsigned int seed) : state(seed) {}
+
+  // uniform in [0,1)
+  double operator()()
+  {
+    state = (1664525u * state + 1013904223u) & 0xFFFFFFFFu;
+    return static_cast<double>(state >> 8) / 16777216.0;
+  }
+
+private:
+  unsigned int state;
+};
+
+
+
+// unit cube of resolution^3 cubes, each split into 6 tetrahedra, returns the
+// number of cells
+std::size_t make_cube_mesh(viennagrid::mesh & mesh, int resolution)
+{
+  typedef viennagrid::mesh                                    MeshType;
+  typedef viennagrid::result_of::element<MeshType>::type      VertexType;
+
+  int vertex_resolution = resolution+1;
+  std::vector<VertexType> vertices;
+  for (int z = 0; z != vertex_resolution; ++z)
+    for (int y = 0; y != vertex_resolution; ++y)
+      for (int x = 0; x != vertex_resolution; ++x)
+        vertices.push_back( viennagrid::make_vertex(mesh,
+          viennagrid::make_point( static_cast<double>(x)/resolution,
+                                  static_cast<double>(y)/resolution,
+                                  static_cast<double>(z)/resolution ) ) );
+
+  static const int kuhn_tetrahedra[6][4] = { {0,1,3,7}, {0,1,5,7}, {0,2,3,7},
+                                             {0,2,6,7}, {0,4,5,7}, {0,4,6,7} };
+
+  for (int z = 0; z != resolution; ++z)
+    for (int y = 0; y != resolution; ++y)
+      for (int x = 0; x != resolution; ++x)
+      {
+        VertexType cube[8];
+        for (int i = 0; i != 8; ++i)
+          cube[i] = vertices[ ((z+(i>>2&1))*vertex_resolution + (y+(i>>1&1)))*vertex_resolution + (x+(i&1)) ];
+
+        for (int t = 0; t != 6; ++t)
+          viennagrid::make_tetrahedron( mesh,
+            cube[kuhn_tetrahedra[t][0]], cube[kuhn_tetrahedra[t][1]],
+            cube[kuhn_tetrahedra[t][2]], cube[kuhn_tetrahedra[t][3]] );
+      }
+
+  return 6*resolution*resolution*resolution;
+}
+
+
+// closed triangle hull of the unit sphere with at least triangle_count
+// triangles, built from rings of latitude, returns the number of triangles
+std::size_t make_sphere_hull(viennagrid::mesh & mesh, int triangle_count)
+{
+  typedef viennagrid::mesh                                    MeshType;
+  typedef viennagrid::result_of::element<MeshType>::type      VertexType;
+
+  // 2*segments*(rings-1) triangles with segments = 2*rings
+  int rings = 2;
+  while (4*rings*(rings-1) < triangle_count)
+    ++rings;
+  int segments = 2*rings;
+
+  VertexType north = viennagrid::make_vertex( mesh, viennagrid::make_point(0, 0, 1) );
+  VertexType south = viennagrid::make_vertex( mesh, viennagrid::make_point(0, 0, -1) );
+
+  std::vector<VertexType> vertices;
+  for (int r = 1; r != rings; ++r)
+  {
+    double theta = M_PI * r / rings;
+    for (int s = 0; s != segments; ++s)
+    {
+      double phi = 2.0 * M_PI * s / segments;
+      vertices.push_back( viennagrid::make_vertex(mesh,
+        viennagrid::make_point( std::sin(theta)*std::cos(phi),
+                                std::sin(theta)*std::sin(phi),
+                                std::cos(theta) ) ) );
+    }
+  }
+
+  for (int s = 0; s != segments; ++s)
+  {
+    int next = (s+1) % segments;
+    viennagrid::make_triangle( mesh, north, vertices[s], vertices[next] );
+    viennagrid::make_triangle( mesh, south,
+                               vertices[(rings-2)*segments + next],
+                               vertices[(rings-2)*segments + s] );
+
+    for (int r = 0; r+2 < rings; ++r)
+    {
+      VertexType v00 = vertices[r*segments + s];
+      VertexType v01 = vertices[r*segments + next];
+      VertexType v10 = vertices[(r+1)*segments + s];
+      VertexType v11 = vertices[(r+1)*segments + next];
+
+      viennagrid::make_triangle( mesh, v00, v10, v11 );
+      viennagrid::make_triangle( mesh, v00, v11, v01 );
+    }
+  }
+
+  return 2*segments*(rings-1);
+}
+
+
+// random star-shaped polygon around the origin as 2D line mesh, returns the
+// number of lines
+std::size_t make_random_plc(viennagrid::mesh & mesh, int vertex_count, random_generator & random)
+{
+  typedef viennagrid::mesh                                    MeshType;
+  typedef viennagrid::result_of::element<MeshType>::type      VertexType;
+
+  std::vector<VertexType> vertices;
+  for (int i = 0; i != vertex_count; ++i)
+  {
+    double phi = 2.0 * M_PI * i / vertex_count;
+    double radius = 0.5 + 0.5*random();
+    vertices.push_back( viennagrid::make_vertex(mesh,
+      viennagrid::make_point( radius*std::cos(phi), radius*std::sin(phi) ) ) );
+  }
+
+  for (int i = 0; i != vertex_count; ++i)
+    viennagrid::make_line( mesh, vertices[i], vertices[(i+1) % vertex_count] );
+
+  return vertex_count;
+}
+
+
+// random points in the unit square or cube without any cells, returns the
+// number of points
+std::size_t make_point_cloud(viennagrid::mesh & mesh, int point_count, int dimension, random_generator & random)
+{
+  for (int i = 0; i != point_count; ++i)
+  {
+    double x = random();
+    double y = random();
+    if (dimension == 2)
+      viennagrid::make_vertex( mesh, viennagrid::make_point(x, y) );
+    else
+      viennagrid::make_vertex( mesh, viennagrid::make_point(x, y, random()) );
+  }
+
+  return point_count;
+}
+
+
+
+
+struct benchmark_result
+{
+  std::string name;
+  std::string algorithm;
+  std::string generator;
+  int size;
+  std::size_t input_elements;
+  int repetitions;
+  double min_time;
+  double mean_time;
+  double max_time;
+};
+
+
+class benchmark_suite
+{
+public:
+
+  explicit benchmark_suite(int repetitions_) : repetitions(repetitions_) {}
+
+
+  // runs the algorithm repetitions times with its current inputs, false if the
+  // algorithm is not available or fails
+  bool run(std::string const & name,
+           std::string const & generator, int size, std::size_t input_elements,
+           viennamesh::algorithm_handle & algorithm, std::string const & algorithm_name)
+  {
+    benchmark_result result;
+    result.name = name;
+    result.algorithm = algorithm_name;
+    result.generator = generator;
+    result.size = size;
+    result.input_elements = input_elements;
+    result.repetitions = repetitions;
+    result.min_time = 0.0;
+    result.mean_time = 0.0;
+    result.max_time = 0.0;
+
+    try
+    {
+      for (int i = 0; i != repetitions; ++i)
+      {
+        viennautils::Timer timer;
+        timer.start();
+
+        if (!algorithm.run())
+        {
+          std::cerr << name << ": algorithm \"" << algorithm_name << "\" failed, skipped" << std::endl;
+          return false;
+        }
+
+        add_time(result, i, timer.get());
+      }
+    }
+    catch (std::exception const & ex)
+    {
+      std::cerr << name << ": " << ex.what() << ", skipped" << std::endl;
+      return false;
+    }
+
+    add_result(result);
+    return true;
+  }
+
+
+  // creates the algorithm, false if it is not available
+  bool make_algorithm(viennamesh::context_handle & context,
+                      std::string const & algorithm_name,
+                      viennamesh::algorithm_handle & algorithm)
+  {
+    try
+    {
+      algorithm = context.make_algorithm(algorithm_name);
+    }
+    catch (std::exception const & ex)
+    {
+      std::cerr << "algorithm \"" << algorithm_name << "\" is not available: " << ex.what() << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+
+  static void add_time(benchmark_result & result, int repetition, double time)
+  {
+    if (repetition == 0 || time < result.min_time)
+      result.min_time = time;
+    if (repetition == 0 || time > result.max_time)
+      result.max_time = time;
+    result.mean_time += time / result.repetitions;
+  }
+
+  void add_result(benchmark_result const & result)
+  {
+    std::cout << result.name << "  " << result.generator << "(" << result.size << ")"
+              << "  elements = " << result.input_elements
+              << "  min = " << result.min_time << "s  mean = " << result.mean_time << "s" << std::endl;
+    results.push_back(result);
+  }
+
+
+  void write_json(std::ostream & stream) const
+  {
+    stream << "{\n";
+    stream << "  \"thread_count\": " << viennamesh::thread_count() << ",\n";
+    stream << "  \"repetitions\": " << repetitions << ",\n";
+    stream << "  \"benchmarks\": [";
+
+    stream.precision(9);
+    for (std::size_t i = 0; i != results.size(); ++i)
+    {
+      benchmark_result const & result = results[i];
+
+      stream << (i == 0 ? "\n" : ",\n");
+      stream << "    { \"name\": \"" << json_escape(result.name) << "\""
+             << ", \"algorithm\": \"" << json_escape(result.algorithm) << "\""
+             << ", \"generator\": \"" << json_escape(result.generator) << "\""
+             << ", \"size\": " << result.size
+             << ", \"input_elements\": " << result.input_elements
+             << ", \"repetitions\": " << result.repetitions
+             << ", \"min_time\": " << result.min_time
+             << ", \"mean_time\": " << result.mean_time
+             << ", \"max_time\": " << result.max_time << " }";
+    }
+
+    stream << "\n  ]\n}\n";
+  }
+
+private:
+
+  static std::string json_escape(std::string const & str)
+  {
+    std::string escaped;
+    for (std::size_t i = 0; i != str.size(); ++i)
+    {
+      if (str[i] == '"' || str[i] == '\\')
+        escaped += '\\';
+      escaped += str[i];
+    }
+    return escaped;
+  }
+
+  int repetitions;
+  std::vector<benchmark_result> results;
+};
+
+
+
+
+// runs an algorithm with a mesh input and an optional double parameter
+void benchmark_mesh_algorithm(benchmark_suite & suite, viennamesh::context_handle & context,
+                              std::string const & algorithm_name, std::string const & input_name,
+                              viennamesh::data_handle<viennagrid_mesh> const & mesh,
+                              std::string const & generator, int size, std::size_t input_elements,
+                              std::string const & parameter_name = std::string(), double parameter_value = 0.0)
+{
+  viennamesh::algorithm_handle algorithm;
+  if (!suite.make_algorithm(context, algorithm_name, algorithm))
+    return;
+
+  algorithm.set_input( input_name, mesh );
+  if (!parameter_name.empty())
+    algorithm.set_input( parameter_name, parameter_value );
+  suite.run( algorithm_name, generator, size, input_elements, algorithm, algorithm_name );
+}
+
+
+void benchmark_io(benchmark_suite & suite, viennamesh::context_handle & context,
+                  viennamesh::data_handle<viennagrid_mesh> const & mesh,
+                  std::string const & generator, int size, std::size_t input_elements)
+{
+  std::stringstream ss;
+  ss << "benchmark_" << generator << "_" << size;
+  std::string filename = ss.str();
+
+  viennamesh::algorithm_handle writer;
+  if (suite.make_algorithm(context, "mesh_writer", writer))
+  {
+    writer.set_input( "mesh", mesh );
+
+    writer.set_input( "filename", filename + "_ascii.vtu" );
+    suite.run( "mesh_writer_vtu_ascii", generator, size, input_elements, writer, "mesh_writer" );
+
+    writer.set_input( "filename", filename + "_binary.vtu" );
+    writer.set_input( "binary", true );
+    suite.run( "mesh_writer_vtu_binary", generator, size, input_elements, writer, "mesh_writer" );
+
+    writer.set_input( "filename", filename + "_compressed.vtu" );
+    writer.set_input( "compress", true );
+    suite.run( "mesh_writer_vtu_compressed", generator, size, input_elements, writer, "mesh_writer" );
+  }
+
+  viennamesh::algorithm_handle reader;
+  if (suite.make_algorithm(context, "mesh_reader", reader))
+  {
+    reader.set_input( "filename", filename + "_ascii.vtu" );
+    suite.run( "mesh_reader_vtu_ascii", generator, size, input_elements, reader, "mesh_reader" );
+
+    reader.set_input( "filename", filename + "_binary.vtu" );
+    suite.run( "mesh_reader_vtu_binary", generator, size, input_elements, reader, "mesh_reader" );
+  }
+}
+
+
+// cost of creating and running an algorithm on a single tetrahedron and of
+// parsing and running an XML pipeline of stage_count trivial stages
+void benchmark_pipeline_overhead(benchmark_suite & suite, viennamesh::context_handle & context,
+                                 int stage_count)
+{
+  viennamesh::data_handle<viennagrid_mesh> mesh = context.make_data<viennagrid_mesh>();
+  std::size_t cells = make_cube_mesh( mesh(), 1 );
+
+  int const run_count = 1000;
+  benchmark_result result;
+  result.name = "algorithm_overhead";
+  result.algorithm = "center_mesh";
+  result.generator = "cube";
+  result.size = 1;
+  result.input_elements = cells;
+  result.repetitions = run_count;
+  result.mean_time = 0.0;
+
+  try
+  {
+    for (int i = 0; i != run_count; ++i)
+    {
+      viennautils::Timer timer;
+      timer.start();
+
+      viennamesh::algorithm_handle algorithm = context.make_algorithm("center_mesh");
+      algorithm.set_input( "mesh", mesh );
+      algorithm.run();
+
+      benchmark_suite::add_time(result, i, timer.get());
+    }
+    suite.add_result(result);
+  }
+  catch (std::exception const & ex)
+  {
+    std::cerr << "algorithm_overhead: " << ex.what() << ", skipped" << std::endl;
+  }
+
+
+  viennamesh::algorithm_handle writer;
+  if (!suite.make_algorithm(context, "mesh_writer", writer))
+    return;
+  writer.set_input( "mesh", mesh );
+  writer.set_input( "filename", "benchmark_pipeline_input.vtu" );
+  if (!writer.run())
+    return;
+
+  std::stringstream xml;
+  xml << "<pipeline>\n";
+  xml << "<algorithm type=\"mesh_reader\" name=\"stage_0\">\n"
+      << "  <parameter name=\"filename\" type=\"string\">benchmark_pipeline_input.vtu</parameter>\n"
+      << "</algorithm>\n";
+  for (int i = 1; i <= stage_count; ++i)
+  {
+    xml << "<algorithm type=\"center_mesh\" name=\"stage_" << i << "\">\n"
+        << "  <default_source>stage_" << i-1 << "</default_source>\n"
+        << "</algorithm>\n";
+  }
+  xml << "</pipeline>\n";
+  std::string xml_string = xml.str();
+
+  result.name = "pipeline_overhead";
+  result.algorithm = "algorithm_pipeline";
+  result.size = stage_count;
+  result.repetitions = 100;
+  result.mean_time = 0.0;
+
+  try
+  {
+    for (int i = 0; i != result.repetitions; ++i)
+    {
+      viennautils::Timer timer;
+      timer.start();
+
+      pugi::xml_document pipeline_xml;
+      pipeline_xml.load_string( xml_string.c_str() );
+
+      viennamesh::algorithm_pipeline pipeline(context);
+      if (!pipeline.from_xml( pipeline_xml.child("pipeline") ) || !pipeline.run())
+      {
+        std::cerr << "pipeline_overhead: pipeline failed, skipped" << std::endl;
+        return;
+      }
+
+      benchmark_suite::add_time(result, i, timer.get());
+    }
+    suite.add_result(result);
+  }
+  catch (std::exception const & ex)
+  {
+    std::cerr << "pipeline_overhead: " << ex.what() << ", skipped" << std::endl;
+  }
+}
+
+
+
+
+int main(int argc, char ** argv)
+{
+  std::string output_filename = (argc > 1) ? argv[1] : "viennamesh_benchmarks.json";
+  int repetitions = (argc > 2) ? std::atoi(argv[2]) : 3;
+  int size_count = (argc > 3) ? std::atoi(argv[3]) : 3;
+
+  if (repetitions < 1)
+    repetitions = 1;
+  if (size_count < 1)
+    size_count = 1;
+  if (size_count > 3)
+    size_count = 3;
+
+  viennamesh_log_set_info_level(0);
+  viennamesh_log_set_warning_level(0);
+
+  viennamesh::context_handle context;
+  benchmark_suite suite(repetitions);
+
+  static const int cube_resolutions[3] = { 8, 16, 32 };
+  static const int element_counts[3] = { 1000, 10000, 100000 };
+
+  for (int s = 0; s != size_count; ++s)
+  {
+    int resolution = cube_resolutions[s];
+    viennamesh::data_handle<viennagrid_mesh> cube = context.make_data<viennagrid_mesh>();
+    std::size_t cube_cells = make_cube_mesh( cube(), resolution );
+
+    benchmark_mesh_algorithm( suite, context, "extract_boundary", "mesh", cube, "cube", resolution, cube_cells );
+    benchmark_mesh_algorithm( suite, context, "uniform_refine", "mesh", cube, "cube", resolution, cube_cells );
+    benchmark_mesh_algorithm( suite, context, "center_mesh", "mesh", cube, "cube", resolution, cube_cells );
+    benchmark_io( suite, context, cube, "cube", resolution, cube_cells );
+
+
+    int count = element_counts[s];
+
+    viennamesh::data_handle<viennagrid_mesh> sphere = context.make_data<viennagrid_mesh>();
+    std::size_t sphere_triangles = make_sphere_hull( sphere(), count );
+
+    benchmark_mesh_algorithm( suite, context, "hull_set_regions", "mesh", sphere, "sphere", count, sphere_triangles );
+    benchmark_mesh_algorithm( suite, context, "extract_plc_geometry", "mesh", sphere, "sphere", count, sphere_triangles );
+    benchmark_mesh_algorithm( suite, context, "tetgen_convert", "mesh", sphere, "sphere", count, sphere_triangles );
+    benchmark_mesh_algorithm( suite, context, "tetgen_make_mesh", "geometry", sphere, "sphere", count, sphere_triangles );
+    benchmark_io( suite, context, sphere, "sphere", count, sphere_triangles );
+
+
+    random_generator random(static_cast<unsigned int>(count));
+
+    viennamesh::data_handle<viennagrid_mesh> plc = context.make_data<viennagrid_mesh>();
+    std::size_t plc_lines = make_random_plc( plc(), count, random );
+
+    benchmark_mesh_algorithm( suite, context, "triangle_convert", "mesh", plc, "random_plc", count, plc_lines );
+    benchmark_mesh_algorithm( suite, context, "triangle_make_mesh", "mesh", plc, "random_plc", count, plc_lines );
+    benchmark_mesh_algorithm( suite, context, "line_coarsening", "mesh", plc, "random_plc", count, plc_lines,
+                              "angle", 3.0 );
+
+
+    viennamesh::data_handle<viennagrid_mesh> points = context.make_data<viennagrid_mesh>();
+    std::size_t point_count = make_point_cloud( points(), count, 2, random );
+
+    benchmark_mesh_algorithm( suite, context, "triangle_make_mesh", "mesh", points, "point_cloud_2d", count, point_count );
+
+    viennamesh::data_handle<viennagrid_mesh> points_3d = context.make_data<viennagrid_mesh>();
+    point_count = make_point_cloud( points_3d(), count, 3, random );
+
+    benchmark_mesh_algorithm( suite, context, "merge_close_points", "mesh", points_3d, "point_cloud_3d", count, point_count,
+                              "merge_distance", 1e-3 );
+  }
+
+  benchmark_pipeline_overhead( suite, context, 16 );
+
+
+  std::ofstream file( output_filename.c_str() );
+  if (!file)
+  {
+    std::cerr << "Could not open " << output_filename << " for writing" << std::endl;
+    return 1;
+  }
+  suite.write_json(file);
+
+  std::cout << "Results written to " << output_filename << std::endl;
+  return 0;
+}
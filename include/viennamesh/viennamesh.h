@@ -254,6 +254,10 @@ DYNAMIC_EXPORT viennamesh_error viennamesh_algorithm_get_input_with_type(viennam
                                                                          const char * name,
                                                                          const char * data_type,
                                                                          viennamesh_data_wrapper * data);
+DYNAMIC_EXPORT viennamesh_error viennamesh_algorithm_input_is_unique(viennamesh_algorithm_wrapper algorithm,
+                                                                     const char * name,
+                                                                     viennamesh_data_wrapper data,
+                                                                     int * is_unique);
 
 DYNAMIC_EXPORT viennamesh_error viennamesh_algorithm_clear_outputs(viennamesh_algorithm_wrapper algorithm);
 DYNAMIC_EXPORT viennamesh_error viennamesh_algorithm_set_output(viennamesh_algorithm_wrapper algorithm,
@@ -87,6 +87,10 @@ namespace viennamesh
     abstract_data_handle get_input(std::string const & name);
     abstract_data_handle get_required_input(std::string const & name);
 
+    // true if data, obtained from the input name and held by a single handle,
+    // is referenced by nothing else, including the input itself
+    bool input_is_unique(std::string const & name, abstract_data_handle const & data);
+
 
 
     template<typename DataT>
@@ -225,9 +229,12 @@ namespace viennamesh
       try
       {
         ((AlgorithmT*)internal_algorithm)->run(algorithm_handle);
+        ((AlgorithmT*)internal_algorithm)->release_scratch_arena();
       }
       catch (...)
       {
+        ((AlgorithmT*)internal_algorithm)->release_scratch_arena();
+
         viennamesh_context context;
         viennamesh_algorithm_get_context(algorithm, &context);
         return handle_error(context);
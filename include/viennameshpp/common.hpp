@@ -6,6 +6,7 @@
 #include "viennamesh/viennamesh.h"
 #include "viennamesh/cpp_error.hpp"
 
+#include <set>
 #include <string>
 
 
@@ -161,6 +162,10 @@ namespace viennamesh
   std::string extract_filename( std::string const & path );
   std::string extract_path( std::string const & path );
 
+  // splits a comma separated list of names, surrounding whitespace is trimmed
+  // and empty entries are dropped
+  std::set<std::string> split_names( std::string const & names );
+
 }
 
 
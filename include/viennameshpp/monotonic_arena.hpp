@@ -0,0 +1,234 @@
+#ifndef _VIENNAMESH_MONOTONIC_ARENA_HPP_
+#define _VIENNAMESH_MONOTONIC_ARENA_HPP_
+
+/* ============================================================================
+   Copyright (c) 2011-2014, Institute for Microelectronics,
+                            Institute for Analysis and Scientific Computing,
+                            TU Wien.
+
+                            -----------------
+                ViennaMesh - The Vienna Meshing Framework
+                            -----------------
+
+                    http://viennamesh.sourceforge.net/
+
+   License:         MIT (X11), see file LICENSE in the base directory
+=============================================================================== */
+
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <vector>
+
+namespace viennamesh
+{
+
+  // Bump allocator for scratch data of an algorithm run. Memory is taken from
+  // geometrically growing blocks and never freed individually, only all at
+  // once via rewind() to an earlier mark() or via release(). Rewound blocks
+  // are kept and reused by subsequent allocations.
+  class monotonic_arena
+  {
+  public:
+
+    struct marker
+    {
+      std::size_t block;
+      std::size_t offset;
+    };
+
+    explicit monotonic_arena(std::size_t initial_block_size_ = 64*1024) :
+      initial_block_size(initial_block_size_), current_block(0), current_offset(0), allocations(0) {}
+
+    ~monotonic_arena() { release(); }
+
+
+    void * allocate(std::size_t size, std::size_t alignment)
+    {
+      ++allocations;
+
+      while (current_block < blocks.size())
+      {
+        std::size_t offset = (current_offset + alignment - 1) & ~(alignment - 1);
+        if (offset + size <= blocks[current_block].size)
+        {
+          current_offset = offset + size;
+          return blocks[current_block].memory + offset;
+        }
+
+        ++current_block;
+        current_offset = 0;
+      }
+
+      block new_block;
+      new_block.size = blocks.empty() ? initial_block_size : 2*blocks.back().size;
+      if (new_block.size < size + alignment)
+        new_block.size = size + alignment;
+      new_block.memory = static_cast<char*>( ::operator new(new_block.size) );
+      blocks.push_back(new_block);
+
+      current_offset = size;
+      return new_block.memory;
+    }
+
+
+    marker mark() const
+    {
+      marker m;
+      m.block = current_block;
+      m.offset = current_offset;
+      return m;
+    }
+
+    void rewind(marker const & m)
+    {
+      // the blocks of the marker are gone after a release()
+      if (m.block >= blocks.size())
+      {
+        current_block = blocks.size();
+        current_offset = 0;
+        return;
+      }
+
+      current_block = m.block;
+      current_offset = m.offset;
+    }
+
+    void release()
+    {
+      for (std::size_t i = 0; i != blocks.size(); ++i)
+        ::operator delete(blocks[i].memory);
+      blocks.clear();
+
+      current_block = 0;
+      current_offset = 0;
+    }
+
+
+    // number of allocate() calls since construction
+    std::size_t allocation_count() const { return allocations; }
+    // number of blocks currently requested from the heap
+    std::size_t block_count() const { return blocks.size(); }
+
+    std::size_t capacity() const
+    {
+      std::size_t total = 0;
+      for (std::size_t i = 0; i != blocks.size(); ++i)
+        total += blocks[i].size;
+      return total;
+    }
+
+  private:
+
+    monotonic_arena(monotonic_arena const &);
+    monotonic_arena & operator=(monotonic_arena const &);
+
+    struct block
+    {
+      char * memory;
+      std::size_t size;
+    };
+
+    std::size_t initial_block_size;
+
+    std::vector<block> blocks;
+    std::size_t current_block;
+    std::size_t current_offset;
+
+    std::size_t allocations;
+  };
+
+
+
+  // Rewinds the arena to its state at construction when going out of scope.
+  // Containers using the arena have to be declared after the scope object so
+  // that they are destroyed before the rewind.
+  class arena_scope
+  {
+  public:
+    explicit arena_scope(monotonic_arena & arena_) : arena(arena_), start(arena_.mark()) {}
+    ~arena_scope() { arena.rewind(start); }
+
+  private:
+    arena_scope(arena_scope const &);
+    arena_scope & operator=(arena_scope const &);
+
+    monotonic_arena & arena;
+    monotonic_arena::marker start;
+  };
+
+
+
+  // Standard allocator on top of a monotonic_arena, deallocate() is a no-op.
+  // Without an arena (default constructed or NULL) it falls back to the heap,
+  // so an algorithm can switch between both with the same container types.
+  template<typename T>
+  class arena_allocator
+  {
+  public:
+
+    typedef T               value_type;
+    typedef T *             pointer;
+    typedef T const *       const_pointer;
+    typedef T &             reference;
+    typedef T const &       const_reference;
+    typedef std::size_t     size_type;
+    typedef std::ptrdiff_t  difference_type;
+
+    template<typename U>
+    struct rebind
+    {
+      typedef arena_allocator<U> other;
+    };
+
+    arena_allocator() : arena_(0) {}
+    explicit arena_allocator(monotonic_arena * arena_in) : arena_(arena_in) {}
+
+    template<typename U>
+    arena_allocator(arena_allocator<U> const & other) : arena_(other.arena()) {}
+
+
+    pointer address(reference x) const { return &x; }
+    const_pointer address(const_reference x) const { return &x; }
+
+    pointer allocate(size_type n, void const * = 0)
+    {
+      if (!arena_)
+        return static_cast<pointer>( ::operator new(n * sizeof(T)) );
+
+      // the largest power of two dividing sizeof(T) is a valid alignment for T
+      std::size_t alignment = sizeof(T) & (~sizeof(T) + 1);
+      if (alignment > 16)
+        alignment = 16;
+
+      return static_cast<pointer>( arena_->allocate(n * sizeof(T), alignment) );
+    }
+
+    void deallocate(pointer p, size_type)
+    {
+      if (!arena_)
+        ::operator delete(p);
+    }
+
+    size_type max_size() const { return std::numeric_limits<size_type>::max() / sizeof(T); }
+
+    void construct(pointer p, const_reference value) { new(p) T(value); }
+    void destroy(pointer p) { p->~T(); }
+
+    monotonic_arena * arena() const { return arena_; }
+
+  private:
+    monotonic_arena * arena_;
+  };
+
+  template<typename T, typename U>
+  bool operator==(arena_allocator<T> const & lhs, arena_allocator<U> const & rhs)
+  { return lhs.arena() == rhs.arena(); }
+
+  template<typename T, typename U>
+  bool operator!=(arena_allocator<T> const & lhs, arena_allocator<U> const & rhs)
+  { return lhs.arena() != rhs.arena(); }
+
+}
+
+#endif
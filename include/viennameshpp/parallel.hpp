@@ -0,0 +1,94 @@
+#ifndef _VIENNAMESH_PARALLEL_HPP_
+#define _VIENNAMESH_PARALLEL_HPP_
+
+/* ============================================================================
+   Copyright (c) 2011-2014, Institute for Microelectronics,
+                            Institute for Analysis and Scientific Computing,
+                            TU Wien.
+
+                            -----------------
+                ViennaMesh - The Vienna Meshing Framework
+                            -----------------
+
+                    http://viennamesh.sourceforge.net/
+
+   License:         MIT (X11), see file LICENSE in the base directory
+=============================================================================== */
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+#ifdef VIENNAMESH_WITH_OPENMP
+#include <omp.h>
+#endif
+
+namespace viennamesh
+{
+  inline int thread_count()
+  {
+#ifdef VIENNAMESH_WITH_OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+  }
+
+  inline int thread_id()
+  {
+#ifdef VIENNAMESH_WITH_OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+  }
+
+
+  // sorts one chunk per thread and merges neighbouring chunks pairwise
+  template<typename IteratorT, typename CompareT>
+  void parallel_sort(IteratorT first, IteratorT last, CompareT compare)
+  {
+    long size = last - first;
+    long chunk_count = thread_count();
+
+    if (chunk_count <= 1 || size < 1024*chunk_count)
+    {
+      std::sort(first, last, compare);
+      return;
+    }
+
+    std::vector<long> bounds(chunk_count+1);
+    for (long i = 0; i <= chunk_count; ++i)
+      bounds[i] = size * i / chunk_count;
+
+#ifdef VIENNAMESH_WITH_OPENMP
+    #pragma omp parallel for
+#endif
+    for (long i = 0; i < chunk_count; ++i)
+      std::sort(first + bounds[i], first + bounds[i+1], compare);
+
+    for (long stride = 1; stride < chunk_count; stride *= 2)
+    {
+#ifdef VIENNAMESH_WITH_OPENMP
+      #pragma omp parallel for
+#endif
+      for (long i = 0; i < chunk_count; i += 2*stride)
+      {
+        if (i + stride < chunk_count)
+          std::inplace_merge(first + bounds[i],
+                             first + bounds[i+stride],
+                             first + bounds[std::min(i + 2*stride, chunk_count)],
+                             compare);
+      }
+    }
+  }
+
+  template<typename IteratorT>
+  void parallel_sort(IteratorT first, IteratorT last)
+  {
+    parallel_sort(first, last, std::less<typename std::iterator_traits<IteratorT>::value_type>());
+  }
+}
+
+#endif
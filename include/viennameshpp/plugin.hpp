@@ -4,6 +4,7 @@
 #include "viennagrid/viennagrid.hpp"
 #include "viennameshpp/core.hpp"
 #include "viennameshpp/exceptions.hpp"
+#include "viennameshpp/monotonic_arena.hpp"
 
 namespace viennamesh
 {
@@ -50,6 +51,9 @@ namespace viennamesh
     typename result_of::data_handle<DataT>::type get_required_input(std::string const & name)
     { return algorithm().get_required_input<DataT>(name); }
 
+    bool input_is_unique(std::string const & name, abstract_data_handle const & data)
+    { return algorithm().input_is_unique(name, data); }
+
 
 
     void set_output(std::string const & name, abstract_data_handle data)
@@ -71,10 +75,33 @@ namespace viennamesh
     context_handle context() { return algorithm().context(); }
 
 
+    // scratch memory for plugin-local containers, released after each run
+    monotonic_arena & scratch_arena() { return scratch_arena_; }
+    void release_scratch_arena() { scratch_arena_.release(); }
+
+
+    // Output mesh of algorithms which only change vertex coordinates. If the
+    // input mesh, held by the single handle input_mesh of the caller, is not
+    // referenced by anyone else, not even by the input itself (e.g. a
+    // converted input), it is returned and changed by the algorithm.
+    // Otherwise a copy of the input mesh is returned.
+    mesh_handle make_coordinate_output(std::string const & input_name, mesh_handle const & input_mesh)
+    {
+      if (input_is_unique(input_name, input_mesh))
+        return input_mesh;
+
+      mesh_handle output_mesh = make_data<mesh_handle>();
+      viennagrid::copy( input_mesh(), output_mesh() );
+      return output_mesh;
+    }
+
+
   private:
 
     algorithm_handle algorithm() { return algorithm_handle(algorithm_wrapper); }
     viennamesh_algorithm_wrapper algorithm_wrapper;
+
+    monotonic_arena scratch_arena_;
   };
 
   void plugin_init( context_handle & context );
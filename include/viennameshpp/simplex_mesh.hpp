@@ -0,0 +1,351 @@
+#ifndef _VIENNAMESH_SIMPLEX_MESH_HPP_
+#define _VIENNAMESH_SIMPLEX_MESH_HPP_
+
+/* ============================================================================
+   Copyright (c) 2011-2014, Institute for Microelectronics,
+                            Institute for Analysis and Scientific Computing,
+                            TU Wien.
+
+                            -----------------
+                ViennaMesh - The Vienna Meshing Framework
+                            -----------------
+
+                    http://viennamesh.sourceforge.net/
+
+   License:         MIT (X11), see file LICENSE in the base directory
+=============================================================================== */
+
+#include <vector>
+#include <algorithm>
+
+#include "viennagrid/viennagrid.hpp"
+#include "viennameshpp/parallel.hpp"
+
+namespace viennamesh
+{
+  // Line, triangle or tetrahedron mesh in flat arrays, vertices and cells by
+  // index. Cell i has the vertices cell_vertices[i*vertices_per_cell] to
+  // cell_vertices[(i+1)*vertices_per_cell-1] and the sorted region ids
+  // cell_regions[cell_region_offsets[i]] to cell_regions[cell_region_offsets[i+1]-1].
+  // Meshes without regions may leave cell_region_offsets empty.
+  struct simplex_mesh
+  {
+    simplex_mesh() : geometric_dimension(0), vertices_per_cell(0) {}
+
+    int geometric_dimension;
+    int vertices_per_cell;
+
+    std::vector<viennagrid_numeric> coords;
+    std::vector<viennagrid_int> cell_vertices;
+    std::vector<viennagrid_int> cell_region_offsets;
+    std::vector<viennagrid_region_id> cell_regions;
+
+    viennagrid_int vertex_count() const
+    { return geometric_dimension == 0 ? 0 : coords.size() / geometric_dimension; }
+    viennagrid_int cell_count() const
+    { return vertices_per_cell == 0 ? 0 : cell_vertices.size() / vertices_per_cell; }
+
+    viennagrid_int region_count(viennagrid_int cell) const
+    { return cell_region_offsets.empty() ? 0 : cell_region_offsets[cell+1] - cell_region_offsets[cell]; }
+
+    bool same_regions(viennagrid_int lhs, viennagrid_int rhs) const
+    {
+      viennagrid_int count = region_count(lhs);
+      if (count != region_count(rhs))
+        return false;
+      return count == 0 ||
+             std::equal( cell_regions.begin() + cell_region_offsets[lhs],
+                         cell_regions.begin() + cell_region_offsets[lhs] + count,
+                         cell_regions.begin() + cell_region_offsets[rhs] );
+    }
+  };
+
+
+  // local vertices of the edges of a triangle and a tetrahedron
+  int const triangle_edges[3][2] = { {0,1}, {0,2}, {1,2} };
+  int const tetrahedron_edges[6][2] = { {0,1}, {0,2}, {0,3}, {1,2}, {1,3}, {2,3} };
+
+
+  inline viennagrid_element_type simplex_type(int vertices_per_cell)
+  {
+    switch (vertices_per_cell)
+    {
+      case 2: return VIENNAGRID_ELEMENT_TYPE_LINE;
+      case 3: return VIENNAGRID_ELEMENT_TYPE_TRIANGLE;
+      case 4: return VIENNAGRID_ELEMENT_TYPE_TETRAHEDRON;
+      default: return VIENNAGRID_ELEMENT_TYPE_NO_ELEMENT;
+    }
+  }
+
+
+  // coordinates of all vertices by vertex index
+  inline void read_vertex_coords(viennagrid::mesh const & input, std::vector<viennagrid_numeric> & coords)
+  {
+    typedef viennagrid::mesh                                                MeshType;
+    typedef viennagrid::result_of::point<MeshType>::type                    PointType;
+
+    typedef viennagrid::result_of::const_vertex_range<MeshType>::type       ConstVertexRangeType;
+    typedef viennagrid::result_of::iterator<ConstVertexRangeType>::type     ConstVertexIteratorType;
+
+    int geometric_dimension = viennagrid::geometric_dimension(input);
+
+    ConstVertexRangeType vertices(input);
+    coords.resize( vertices.size() * geometric_dimension );
+    for (ConstVertexIteratorType vit = vertices.begin(); vit != vertices.end(); ++vit)
+    {
+      PointType p = viennagrid::get_point(*vit);
+      viennagrid_int index = (*vit).id().index();
+      for (int d = 0; d != geometric_dimension; ++d)
+        coords[index*geometric_dimension + d] = p[d];
+    }
+  }
+
+
+  // Reads the elements of the given dimension of input as the cells of mesh,
+  // with all vertices of input. Returns false if they are not all lines,
+  // triangles or tetrahedra.
+  inline bool read_simplex_mesh(viennagrid::mesh const & input, viennagrid_dimension dimension, simplex_mesh & mesh)
+  {
+    typedef viennagrid::mesh                                                MeshType;
+    typedef viennagrid::result_of::element<MeshType>::type                  ElementType;
+
+    typedef viennagrid::result_of::const_element_range<MeshType>::type      ConstElementRangeType;
+    typedef viennagrid::result_of::iterator<ConstElementRangeType>::type    ConstElementIteratorType;
+
+    typedef viennagrid::result_of::const_element_range<ElementType>::type   ConstBoundaryRangeType;
+    typedef viennagrid::result_of::iterator<ConstBoundaryRangeType>::type   ConstBoundaryIteratorType;
+
+    typedef viennagrid::result_of::region_range<ElementType>::type          ElementRegionRangeType;
+    typedef viennagrid::result_of::iterator<ElementRegionRangeType>::type   ElementRegionRangeIterator;
+
+    if (dimension < 1 || dimension > 3)
+      return false;
+
+    mesh.vertices_per_cell = dimension+1;
+    viennagrid_element_type cell_type = simplex_type(mesh.vertices_per_cell);
+
+    ConstElementRangeType cells(input, dimension);
+    viennagrid_int cell_count = cells.size();
+    mesh.cell_vertices.resize( cell_count * mesh.vertices_per_cell );
+    mesh.cell_region_offsets.assign( cell_count+1, 0 );
+
+    // counting the regions of each cell first allows cells in any index order
+    for (ConstElementIteratorType cit = cells.begin(); cit != cells.end(); ++cit)
+    {
+      if ( (*cit).tag().internal() != cell_type )
+        return false;
+
+      viennagrid_int index = (*cit).id().index();
+      viennagrid_int * vertices = &mesh.cell_vertices[index*mesh.vertices_per_cell];
+      ConstBoundaryRangeType cell_vertices(*cit, 0);
+      for (ConstBoundaryIteratorType vit = cell_vertices.begin(); vit != cell_vertices.end(); ++vit)
+        *vertices++ = (*vit).id().index();
+
+      ElementRegionRangeType cell_regions(*cit);
+      for (ElementRegionRangeIterator rit = cell_regions.begin(); rit != cell_regions.end(); ++rit)
+        ++mesh.cell_region_offsets[index+1];
+    }
+
+    for (viennagrid_int i = 0; i != cell_count; ++i)
+      mesh.cell_region_offsets[i+1] += mesh.cell_region_offsets[i];
+
+    mesh.cell_regions.resize( mesh.cell_region_offsets[cell_count] );
+    for (ConstElementIteratorType cit = cells.begin(); cit != cells.end(); ++cit)
+    {
+      viennagrid_int index = (*cit).id().index();
+      std::vector<viennagrid_region_id>::iterator first = mesh.cell_regions.begin() + mesh.cell_region_offsets[index];
+      std::vector<viennagrid_region_id>::iterator regions = first;
+
+      ElementRegionRangeType cell_regions(*cit);
+      for (ElementRegionRangeIterator rit = cell_regions.begin(); rit != cell_regions.end(); ++rit)
+        *regions++ = (*rit).id();
+      std::sort( first, regions );
+    }
+
+    mesh.geometric_dimension = viennagrid::geometric_dimension(input);
+    read_vertex_coords(input, mesh.coords);
+
+    return true;
+  }
+
+
+  // Drops the vertices no cell uses, the others are renumbered in the order
+  // of their first use.
+  inline void compact_vertices(simplex_mesh & mesh)
+  {
+    int geometric_dimension = mesh.geometric_dimension;
+    std::vector<viennagrid_int> vertex_map( mesh.vertex_count(), -1 );
+    std::vector<viennagrid_numeric> coords;
+
+    for (std::size_t i = 0; i != mesh.cell_vertices.size(); ++i)
+    {
+      viennagrid_int & vertex = mesh.cell_vertices[i];
+      if (vertex_map[vertex] == -1)
+      {
+        vertex_map[vertex] = coords.size() / geometric_dimension;
+        coords.insert( coords.end(),
+                       mesh.coords.begin() + vertex*geometric_dimension,
+                       mesh.coords.begin() + (vertex+1)*geometric_dimension );
+      }
+      vertex = vertex_map[vertex];
+    }
+
+    mesh.coords.swap(coords);
+  }
+
+
+  // creates the regions of input with their names in output
+  inline void copy_regions(viennagrid::mesh const & input, viennagrid::mesh const & output)
+  {
+    typedef viennagrid::result_of::region_range<viennagrid::mesh>::type     RegionRangeType;
+    typedef viennagrid::result_of::iterator<RegionRangeType>::type          RegionRangeIterator;
+
+    RegionRangeType regions(input);
+    for (RegionRangeIterator rit = regions.begin(); rit != regions.end(); ++rit)
+      output.get_or_create_region( (*rit).id() ).set_name( (*rit).get_name() );
+  }
+
+
+  // Creates the vertices and cells of mesh in output and adds each cell to
+  // its regions, which are created if output does not have them yet.
+  inline void make_simplex_mesh(simplex_mesh const & mesh, viennagrid::mesh const & output)
+  {
+    typedef viennagrid::mesh                                          MeshType;
+    typedef viennagrid::result_of::point<MeshType>::type              PointType;
+    typedef viennagrid::result_of::element<MeshType>::type            ElementType;
+
+    int geometric_dimension = mesh.geometric_dimension;
+    viennagrid_int vertex_count = mesh.vertex_count();
+    viennagrid_int cell_count = mesh.cell_count();
+
+    std::vector<viennagrid_element_id> vertex_ids(vertex_count);
+    PointType p(geometric_dimension);
+    for (viennagrid_int i = 0; i != vertex_count; ++i)
+    {
+      for (int d = 0; d != geometric_dimension; ++d)
+        p[d] = mesh.coords[i*geometric_dimension + d];
+      vertex_ids[i] = viennagrid::make_vertex(output, p).id().internal();
+    }
+
+    if (cell_count == 0)
+      return;
+
+    std::vector<viennagrid_region_id> region_ids( mesh.cell_regions );
+    std::sort( region_ids.begin(), region_ids.end() );
+    region_ids.erase( std::unique(region_ids.begin(), region_ids.end()), region_ids.end() );
+    for (std::size_t i = 0; i != region_ids.size(); ++i)
+      output.get_or_create_region( region_ids[i] );
+
+    std::vector<viennagrid_element_type> cell_types( cell_count, simplex_type(mesh.vertices_per_cell) );
+    std::vector<viennagrid_int> cell_vertex_offsets( cell_count+1 );
+    for (viennagrid_int i = 0; i <= cell_count; ++i)
+      cell_vertex_offsets[i] = i * mesh.vertices_per_cell;
+
+    std::vector<viennagrid_element_id> cell_vertices( mesh.cell_vertices.size() );
+#ifdef VIENNAMESH_WITH_OPENMP
+    #pragma omp parallel for
+#endif
+    for (long i = 0; i < static_cast<long>(cell_vertices.size()); ++i)
+      cell_vertices[i] = vertex_ids[ mesh.cell_vertices[i] ];
+
+    // the first region of each cell is assigned in the batch if every cell
+    // has one, all other regions are added afterwards
+    std::vector<viennagrid_region_id> first_regions(cell_count);
+    bool all_cells_in_region = true;
+    bool has_additional_regions = false;
+    for (viennagrid_int i = 0; i != cell_count; ++i)
+    {
+      viennagrid_int region_count = mesh.region_count(i);
+      if (region_count == 0)
+        all_cells_in_region = false;
+      else
+        first_regions[i] = mesh.cell_regions[ mesh.cell_region_offsets[i] ];
+      if (region_count > 1)
+        has_additional_regions = true;
+    }
+
+    std::vector<viennagrid_element_id> cell_ids(cell_count);
+    viennagrid_mesh_element_batch_create( output.internal(),
+                                          cell_count, &cell_types[0],
+                                          &cell_vertex_offsets[0], &cell_vertices[0],
+                                          all_cells_in_region ? &first_regions[0] : NULL,
+                                          &cell_ids[0] );
+
+    if (has_additional_regions || (!all_cells_in_region && !mesh.cell_regions.empty()))
+    {
+      for (viennagrid_int i = 0; i != cell_count; ++i)
+      {
+        viennagrid_int first = mesh.cell_region_offsets[i] + (all_cells_in_region ? 1 : 0);
+        for (viennagrid_int j = first; j < mesh.cell_region_offsets[i+1]; ++j)
+        {
+          ElementType cell( output, cell_ids[i] );
+          viennagrid::add( output.get_or_create_region(mesh.cell_regions[j]), cell );
+        }
+      }
+    }
+  }
+
+
+  // Cells of each vertex by counting sort, the cells of vertex v are
+  // vertex_cells[vertex_cell_offsets[v]] to vertex_cells[vertex_cell_offsets[v+1]-1]
+  // in increasing order.
+  inline void make_vertex_cells(simplex_mesh const & mesh,
+                                std::vector<viennagrid_int> & vertex_cell_offsets,
+                                std::vector<viennagrid_int> & vertex_cells)
+  {
+    viennagrid_int vertex_count = mesh.vertex_count();
+    vertex_cell_offsets.assign( vertex_count+1, 0 );
+    for (std::size_t i = 0; i != mesh.cell_vertices.size(); ++i)
+      ++vertex_cell_offsets[ mesh.cell_vertices[i]+1 ];
+    for (viennagrid_int i = 0; i != vertex_count; ++i)
+      vertex_cell_offsets[i+1] += vertex_cell_offsets[i];
+
+    vertex_cells.resize( mesh.cell_vertices.size() );
+    std::vector<viennagrid_int> fill( vertex_cell_offsets.begin(), vertex_cell_offsets.end()-1 );
+    for (std::size_t i = 0; i != mesh.cell_vertices.size(); ++i)
+      vertex_cells[ fill[mesh.cell_vertices[i]]++ ] = i / mesh.vertices_per_cell;
+  }
+
+
+  // an edge between the vertices v0 < v1 found at slot of some per-cell edge table
+  struct edge_slot
+  {
+    edge_slot() {}
+    edge_slot(viennagrid_int a, viennagrid_int b, viennagrid_int slot_) :
+        v0( std::min(a, b) ), v1( std::max(a, b) ), slot(slot_) {}
+
+    viennagrid_int v0;
+    viennagrid_int v1;
+    viennagrid_int slot;
+  };
+
+  struct edge_slot_less
+  {
+    bool operator()(edge_slot const & lhs, edge_slot const & rhs) const
+    { return lhs.v0 < rhs.v0 || (lhs.v0 == rhs.v0 && lhs.v1 < rhs.v1); }
+  };
+
+  // Numbers the distinct edges of slots in the order of their vertices.
+  // slot_edges[s.slot] is set to the edge index of each slot s, edge i has
+  // the vertices edge_vertices[2*i] and edge_vertices[2*i+1]. slots is released.
+  inline void number_edges(std::vector<edge_slot> & slots,
+                           std::vector<viennagrid_int> & slot_edges,
+                           std::vector<viennagrid_int> & edge_vertices)
+  {
+    parallel_sort( slots.begin(), slots.end(), edge_slot_less() );
+
+    edge_vertices.clear();
+    for (std::size_t i = 0; i != slots.size(); ++i)
+    {
+      if (i == 0 || slots[i].v0 != slots[i-1].v0 || slots[i].v1 != slots[i-1].v1)
+      {
+        edge_vertices.push_back( slots[i].v0 );
+        edge_vertices.push_back( slots[i].v1 );
+      }
+      slot_edges[ slots[i].slot ] = edge_vertices.size()/2 - 1;
+    }
+    std::vector<edge_slot>().swap(slots);
+  }
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef _VIENNAMESH_UNION_FIND_HPP_
+#define _VIENNAMESH_UNION_FIND_HPP_
+
+/* ============================================================================
+   Copyright (c) 2011-2014, Institute for Microelectronics,
+                            Institute for Analysis and Scientific Computing,
+                            TU Wien.
+
+                            -----------------
+                ViennaMesh - The Vienna Meshing Framework
+                            -----------------
+
+                    http://viennamesh.sourceforge.net/
+
+   License:         MIT (X11), see file LICENSE in the base directory
+=============================================================================== */
+
+#include <vector>
+#include <cstddef>
+
+namespace viennamesh
+{
+  // disjoint set forest over the indices [0, size), the representative of each set
+  // is always its smallest index, so the result does not depend on the union order
+  template<typename IndexT = int>
+  class union_find
+  {
+  public:
+
+    explicit union_find(std::size_t size_ = 0) { resize(size_); }
+
+    void resize(std::size_t size_)
+    {
+      std::size_t old_size = parents.size();
+      parents.resize(size_);
+      for (std::size_t i = old_size; i < size_; ++i)
+        parents[i] = static_cast<IndexT>(i);
+    }
+
+    std::size_t size() const { return parents.size(); }
+
+    IndexT find(IndexT index)
+    {
+      // path halving
+      while (parents[index] != index)
+      {
+        parents[index] = parents[ parents[index] ];
+        index = parents[index];
+      }
+      return index;
+    }
+
+    bool unite(IndexT lhs, IndexT rhs)
+    {
+      lhs = find(lhs);
+      rhs = find(rhs);
+
+      if (lhs == rhs)
+        return false;
+
+      if (lhs < rhs)
+        parents[rhs] = lhs;
+      else
+        parents[lhs] = rhs;
+
+      return true;
+    }
+
+    bool same(IndexT lhs, IndexT rhs) { return find(lhs) == find(rhs); }
+
+  private:
+    std::vector<IndexT> parents;
+  };
+}
+
+#endif
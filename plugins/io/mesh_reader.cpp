@@ -121,6 +121,11 @@ namespace viennamesh
         reader(output_mesh(), filename);
 
 
+        // the ViennaGrid VTK reader always decodes all data arrays, selecting
+        // quantities is only supported by the TDR reader
+        if ( get_input<bool>("load_quantities").valid() || get_input<std::string>("quantity_names").valid() )
+          warning(1) << "load_quantities and quantity_names are only supported for TDR files, all quantities are loaded" << std::endl;
+
         std::vector<viennagrid::quantity_field> quantity_fields = reader.quantity_fields();
         if (!quantity_fields.empty())
         {
@@ -13,6 +13,7 @@
 =============================================================================== */
 
 #include "mesh_writer.hpp"
+#include "vtu_binary_writer.hpp"
 
 #include "viennagrid/io/vtk_writer.hpp"
 #include "viennagrid/io/mphtxt_writer.hpp"
@@ -62,6 +63,35 @@ namespace viennamesh
     if (input_mesh.size() != 1)
       info(1) << "Found " << input_mesh.size() << " meshes" << std::endl;
 
+    data_handle<bool> binary = get_input<bool>("binary");
+    data_handle<bool> compress = get_input<bool>("compress");
+    bool binary_vtk = (ft == VTK) && ( (binary.valid() && binary()) || (compress.valid() && compress()) );
+
+    if (binary_vtk && compress.valid() && compress() && !vtu_binary_writer_supports_compression())
+    {
+      error(1) << "Compressed VTU output requested but ViennaMesh was built without zlib" << std::endl;
+      return false;
+    }
+
+    // several meshes, e.g. the partitions of metis_mesh_partitioning, are
+    // written concurrently into one collection
+    if (binary_vtk && input_mesh.size() != 1)
+    {
+      info(1) << "Writing " << input_mesh.size() << " meshes to collection \"" << filename_no_extension << ".pvd\"" << std::endl;
+
+      try
+      {
+        write_to_vtu_binary( filename_no_extension, input_mesh.get_vector(), compress.valid() && compress() );
+      }
+      catch (vtu_writer_error const & e)
+      {
+        error(1) << "Got error while writing meshes to binary VTU files: " << e.what() << std::endl;
+        return false;
+      }
+
+      return true;
+    }
+
     for (int i = 0; i != input_mesh.size(); ++i)
     {
       viennagrid::mesh mesh = input_mesh(i);
@@ -80,6 +110,31 @@ namespace viennamesh
       {
         case VTK:
         {
+          if (binary_vtk)
+          {
+            std::vector<viennagrid::quantity_field> quantity_fields;
+            if (input_mesh.size() == 1 && quantity_field.valid())
+            {
+              quantity_fields = quantity_field.get_vector();
+              for (std::size_t j = 0; j != quantity_fields.size(); ++j)
+              {
+                if (quantity_fields[j].values_per_quantity() != 1)
+                  warning(1) << "Binary VTU writer only supports scalar quantity fields -> skipping quantity field \"" << quantity_fields[j].get_name() << "\"" << std::endl;
+              }
+            }
+
+            try
+            {
+              write_to_vtu_binary( local_filename, mesh, quantity_fields, compress.valid() && compress() );
+            }
+            catch (vtu_writer_error const & e)
+            {
+              error(1) << "Got error while writing mesh to binary VTU file: " << e.what() << std::endl;
+              return false;
+            }
+            break;
+          }
+
           viennagrid::io::vtk_writer<viennagrid::mesh> writer;
 
           if (input_mesh.size() == 1 && quantity_field.valid())
@@ -0,0 +1,737 @@
+/* ============================================================================
+   Copyright (c) 2011-2014, Institute for Microelectronics,
+                            Institute for Analysis and Scientific Computing,
+                            TU Wien.
+
+                            -----------------
+                ViennaMesh - The Vienna Meshing Framework
+                            -----------------
+
+                    http://viennamesh.sourceforge.net/
+
+   License:         MIT (X11), see file LICENSE in the base directory
+=============================================================================== */
+
+#include "vtu_binary_writer.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <boost/cstdint.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "viennagrid/core/range.hpp"
+
+#include "viennameshpp/parallel.hpp"
+
+#ifdef VIENNAMESH_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+namespace viennamesh
+{
+namespace
+{
+typedef viennagrid::const_mesh                                          MeshType;
+typedef viennagrid::result_of::element<MeshType>::type                  ElementType;
+typedef viennagrid::result_of::point<MeshType>::type                    PointType;
+typedef viennagrid::result_of::region<MeshType>::type                   RegionType;
+
+typedef viennagrid::result_of::const_vertex_range<ElementType>::type    BoundaryVertexRange;
+
+typedef viennagrid::result_of::const_region_range<MeshType>::type       RegionRange;
+typedef viennagrid::result_of::iterator<RegionRange>::type              RegionIterator;
+
+// number of uncompressed bytes per compressed block, the VTK default
+const std::size_t block_size = 32768;
+
+// width of the zero padded offset attributes which are patched after writing
+const int offset_width = 20;
+
+
+bool little_endian()
+{
+  boost::uint16_t value = 1;
+  return *reinterpret_cast<unsigned char const *>(&value) == 1;
+}
+
+unsigned char vtk_cell_type(viennagrid_element_type tag)
+{
+  switch (tag)
+  {
+    case VIENNAGRID_ELEMENT_TYPE_VERTEX: return 1;
+    case VIENNAGRID_ELEMENT_TYPE_LINE: return 3;
+    case VIENNAGRID_ELEMENT_TYPE_TRIANGLE: return 5;
+    case VIENNAGRID_ELEMENT_TYPE_QUADRILATERAL: return 9;
+    case VIENNAGRID_ELEMENT_TYPE_TETRAHEDRON: return 10;
+    case VIENNAGRID_ELEMENT_TYPE_HEXAHEDRON: return 12;
+    default:
+      throw viennautils::make_exception<vtu_writer_error>("Element type " + boost::lexical_cast<std::string>(tag) + " not supported by the VTU writer");
+  }
+}
+
+// viennagrid orders the vertices of quadrilaterals and hexahedra like a tensor
+// product, VTK orders them cyclically
+int vtk_vertex_index(viennagrid_element_type tag, int i)
+{
+  static const int quadrilateral[4] = {0, 1, 3, 2};
+  static const int hexahedron[8] = {0, 1, 3, 2, 4, 5, 7, 6};
+
+  if (tag == VIENNAGRID_ELEMENT_TYPE_QUADRILATERAL)
+    return quadrilateral[i];
+  if (tag == VIENNAGRID_ELEMENT_TYPE_HEXAHEDRON)
+    return hexahedron[i];
+  return i;
+}
+
+
+// Streams one array of the appended data section. The uncompressed byte count
+// is known in advance, so the array header has a fixed size and only the
+// compressed block sizes are patched in when the array is finished.
+class appended_array_writer
+{
+public:
+
+  appended_array_writer(std::ofstream & stream_, bool compress_, boost::uint64_t byte_count_) :
+      stream(stream_), compress(compress_), byte_count(byte_count_), written(0), block(0)
+  {
+    buffer.reserve(2*block_size);
+
+    if (compress)
+    {
+      boost::uint64_t block_count = (byte_count + block_size - 1) / block_size;
+      header.resize(3 + block_count, 0);
+      header[0] = block_count;
+      header[1] = block_size;
+      header[2] = byte_count % block_size;
+    }
+    else
+      header.push_back(byte_count);
+
+    header_position = stream.tellp();
+    stream.write( reinterpret_cast<char const *>(&header[0]), header.size()*sizeof(boost::uint64_t) );
+  }
+
+  template<typename T>
+  void write(T value)
+  {
+    char const * bytes = reinterpret_cast<char const *>(&value);
+    buffer.insert( buffer.end(), bytes, bytes+sizeof(T) );
+
+    if (buffer.size() >= block_size)
+      flush(block_size);
+  }
+
+  template<typename T>
+  void write(T const * values, std::size_t count)
+  {
+    char const * bytes = reinterpret_cast<char const *>(values);
+    std::size_t size = count*sizeof(T);
+    while (size != 0)
+    {
+      std::size_t part = std::min(size, block_size - buffer.size());
+      buffer.insert( buffer.end(), bytes, bytes+part );
+      bytes += part;
+      size -= part;
+
+      if (buffer.size() >= block_size)
+        flush(block_size);
+    }
+  }
+
+  void finish()
+  {
+    while (!buffer.empty())
+      flush( std::min(buffer.size(), block_size) );
+
+    if (written != byte_count)
+      throw viennautils::make_exception<vtu_writer_error>("VTU writer: array size does not match its header");
+
+    if (compress)
+    {
+      std::streampos end_position = stream.tellp();
+      stream.seekp(header_position);
+      stream.write( reinterpret_cast<char const *>(&header[0]), header.size()*sizeof(boost::uint64_t) );
+      stream.seekp(end_position);
+    }
+  }
+
+private:
+
+  void flush(std::size_t size)
+  {
+#ifdef VIENNAMESH_WITH_ZLIB
+    if (compress)
+    {
+      uLongf compressed_size = compressBound(size);
+      compressed.resize(compressed_size);
+      if (compress2(&compressed[0], &compressed_size, reinterpret_cast<Bytef const *>(&buffer[0]), size, Z_DEFAULT_COMPRESSION) != Z_OK)
+        throw viennautils::make_exception<vtu_writer_error>("VTU writer: zlib compression failed");
+
+      header[3 + block++] = compressed_size;
+      stream.write( reinterpret_cast<char const *>(&compressed[0]), compressed_size );
+    }
+    else
+#endif
+      stream.write( &buffer[0], size );
+
+    written += size;
+    buffer.erase( buffer.begin(), buffer.begin()+size );
+  }
+
+  std::ofstream & stream;
+  bool compress;
+
+  boost::uint64_t byte_count;
+  boost::uint64_t written;
+
+  std::vector<boost::uint64_t> header;
+  std::streampos header_position;
+  std::size_t block;
+
+  std::vector<char> buffer;
+#ifdef VIENNAMESH_WITH_ZLIB
+  std::vector<Bytef> compressed;
+#endif
+};
+
+
+// VTU file with the XML part written first, the offsets into the appended
+// data section are zero padded placeholders which are filled in by finish()
+class appended_vtu_file
+{
+public:
+
+  appended_vtu_file(std::string const & filename, bool compress_) : compress(compress_)
+  {
+    stream.open(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!stream)
+      throw viennautils::make_exception<vtu_writer_error>("VTU writer: could not open file \"" + filename + "\" for writing");
+  }
+
+  std::ofstream & xml() { return stream; }
+
+  void data_array(std::string const & type, std::string const & name, int components)
+  {
+    stream << "        <DataArray type=\"" << type << "\"";
+    if (!name.empty())
+      stream << " Name=\"" << name << "\"";
+    if (components > 1)
+      stream << " NumberOfComponents=\"" << components << "\"";
+    stream << " format=\"appended\" offset=\"";
+    offset_positions.push_back( stream.tellp() );
+    stream << std::string(offset_width, '0') << "\"/>\n";
+  }
+
+  void begin_appended_data()
+  {
+    stream << "  <AppendedData encoding=\"raw\">\n   _";
+    appended_start = stream.tellp();
+  }
+
+  // starts the next array of the appended data section, in the order of the data_array calls
+  appended_array_writer begin_array(boost::uint64_t byte_count)
+  {
+    offsets.push_back( static_cast<boost::uint64_t>(stream.tellp() - appended_start) );
+    return appended_array_writer(stream, compress, byte_count);
+  }
+
+  void finish()
+  {
+    stream << "\n  </AppendedData>\n";
+    stream << "</VTKFile>\n";
+
+    if (offsets.size() != offset_positions.size())
+      throw viennautils::make_exception<vtu_writer_error>("VTU writer: number of arrays does not match the XML header");
+
+    for (std::size_t i = 0; i != offsets.size(); ++i)
+    {
+      stream.seekp( offset_positions[i] );
+      stream << std::setw(offset_width) << std::setfill('0') << offsets[i];
+    }
+
+    stream.close();
+    if (!stream)
+      throw viennautils::make_exception<vtu_writer_error>("VTU writer: error while writing file");
+  }
+
+private:
+  std::ofstream stream;
+  bool compress;
+
+  std::streampos appended_start;
+  std::vector<std::streampos> offset_positions;
+  std::vector<boost::uint64_t> offsets;
+};
+
+
+void write_vtu_header(appended_vtu_file & file,
+                      boost::uint64_t vertex_count,
+                      boost::uint64_t cell_count,
+                      std::vector<std::string> const & vertex_field_names,
+                      std::vector<std::string> const & cell_field_names,
+                      bool compress)
+{
+  std::ofstream & xml = file.xml();
+
+  xml << "<?xml version=\"1.0\"?>\n";
+  xml << "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"" << (little_endian() ? "LittleEndian" : "BigEndian") << "\" header_type=\"UInt64\"";
+  if (compress)
+    xml << " compressor=\"vtkZLibDataCompressor\"";
+  xml << ">\n";
+  xml << "  <UnstructuredGrid>\n";
+  xml << "    <Piece NumberOfPoints=\"" << vertex_count << "\" NumberOfCells=\"" << cell_count << "\">\n";
+
+  xml << "      <Points>\n";
+  file.data_array("Float64", "", 3);
+  xml << "      </Points>\n";
+
+  xml << "      <Cells>\n";
+  file.data_array("Int64", "connectivity", 1);
+  file.data_array("Int64", "offsets", 1);
+  file.data_array("UInt8", "types", 1);
+  xml << "      </Cells>\n";
+
+  if (!vertex_field_names.empty())
+  {
+    xml << "      <PointData Scalars=\"" << vertex_field_names[0] << "\">\n";
+    for (std::size_t i = 0; i != vertex_field_names.size(); ++i)
+      file.data_array("Float64", vertex_field_names[i], 1);
+    xml << "      </PointData>\n";
+  }
+
+  if (!cell_field_names.empty())
+  {
+    xml << "      <CellData Scalars=\"" << cell_field_names[0] << "\">\n";
+    for (std::size_t i = 0; i != cell_field_names.size(); ++i)
+      file.data_array("Float64", cell_field_names[i], 1);
+    xml << "      </CellData>\n";
+  }
+
+  xml << "    </Piece>\n";
+  xml << "  </UnstructuredGrid>\n";
+
+  file.begin_appended_data();
+}
+
+
+struct vtu_fields
+{
+  std::vector<viennagrid::quantity_field const *> vertex_fields;
+  std::vector<viennagrid::quantity_field const *> cell_fields;
+
+  std::vector<std::string> vertex_field_names;
+  std::vector<std::string> cell_field_names;
+};
+
+
+// dense numbering of the vertices of a piece by their mesh id
+template<typename PieceT>
+boost::uint64_t number_vertices(PieceT const & piece, std::vector<boost::int64_t> & local_index)
+{
+  typedef typename viennagrid::result_of::const_vertex_range<PieceT>::type   VertexRange;
+  typedef typename viennagrid::result_of::iterator<VertexRange>::type        VertexIterator;
+
+  VertexRange vertices(piece);
+
+  viennagrid_int max_vertex_index = -1;
+  for (VertexIterator vit = vertices.begin(); vit != vertices.end(); ++vit)
+    max_vertex_index = std::max( max_vertex_index, (*vit).id().index() );
+
+  local_index.assign( max_vertex_index+1, -1 );
+  boost::uint64_t vertex_count = 0;
+  for (VertexIterator vit = vertices.begin(); vit != vertices.end(); ++vit)
+    local_index[ (*vit).id().index() ] = vertex_count++;
+
+  return vertex_count;
+}
+
+
+// writes a piece directly from the mesh ranges
+template<typename PieceT>
+void write_piece(std::string const & filename,
+                 PieceT const & piece,
+                 vtu_fields const & fields,
+                 bool compress)
+{
+  typedef typename viennagrid::result_of::const_vertex_range<PieceT>::type   VertexRange;
+  typedef typename viennagrid::result_of::iterator<VertexRange>::type        VertexIterator;
+
+  typedef typename viennagrid::result_of::const_cell_range<PieceT>::type     CellRange;
+  typedef typename viennagrid::result_of::iterator<CellRange>::type          CellIterator;
+
+  VertexRange vertices(piece);
+  CellRange cells(piece);
+
+  std::vector<boost::int64_t> local_index;
+  boost::uint64_t vertex_count = number_vertices(piece, local_index);
+
+  boost::uint64_t cell_count = 0;
+  boost::uint64_t connectivity_size = 0;
+  for (CellIterator cit = cells.begin(); cit != cells.end(); ++cit, ++cell_count)
+  {
+    vtk_cell_type( (*cit).tag().internal() );
+    connectivity_size += BoundaryVertexRange(*cit).size();
+  }
+
+
+  appended_vtu_file file(filename, compress);
+  write_vtu_header(file, vertex_count, cell_count, fields.vertex_field_names, fields.cell_field_names, compress);
+
+  {
+    appended_array_writer points = file.begin_array( 3*vertex_count*sizeof(double) );
+    for (VertexIterator vit = vertices.begin(); vit != vertices.end(); ++vit)
+    {
+      PointType point = viennagrid::get_point(*vit);
+      for (std::size_t d = 0; d != 3; ++d)
+        points.write<double>( d < point.size() ? point[d] : 0.0 );
+    }
+    points.finish();
+  }
+
+  {
+    appended_array_writer connectivity = file.begin_array( connectivity_size*sizeof(boost::int64_t) );
+    for (CellIterator cit = cells.begin(); cit != cells.end(); ++cit)
+    {
+      viennagrid_element_type tag = (*cit).tag().internal();
+      BoundaryVertexRange cell_vertices(*cit);
+      for (std::size_t i = 0; i != cell_vertices.size(); ++i)
+        connectivity.write<boost::int64_t>( local_index[ cell_vertices[vtk_vertex_index(tag, i)].id().index() ] );
+    }
+    connectivity.finish();
+  }
+
+  {
+    appended_array_writer offsets = file.begin_array( cell_count*sizeof(boost::int64_t) );
+    boost::int64_t offset = 0;
+    for (CellIterator cit = cells.begin(); cit != cells.end(); ++cit)
+    {
+      offset += BoundaryVertexRange(*cit).size();
+      offsets.write<boost::int64_t>(offset);
+    }
+    offsets.finish();
+  }
+
+  {
+    appended_array_writer types = file.begin_array( cell_count*sizeof(boost::uint8_t) );
+    for (CellIterator cit = cells.begin(); cit != cells.end(); ++cit)
+      types.write<boost::uint8_t>( vtk_cell_type((*cit).tag().internal()) );
+    types.finish();
+  }
+
+  for (std::size_t i = 0; i != fields.vertex_fields.size(); ++i)
+  {
+    viennagrid::quantity_field const & field = *fields.vertex_fields[i];
+    appended_array_writer values = file.begin_array( vertex_count*sizeof(double) );
+    for (VertexIterator vit = vertices.begin(); vit != vertices.end(); ++vit)
+    {
+      viennagrid_int index = (*vit).id().index();
+      values.write<double>( field.valid(index) ? field.get(index) : 0.0 );
+    }
+    values.finish();
+  }
+
+  for (std::size_t i = 0; i != fields.cell_fields.size(); ++i)
+  {
+    viennagrid::quantity_field const & field = *fields.cell_fields[i];
+    appended_array_writer values = file.begin_array( cell_count*sizeof(double) );
+    for (CellIterator cit = cells.begin(); cit != cells.end(); ++cit)
+    {
+      viennagrid_int index = (*cit).id().index();
+      values.write<double>( field.valid(index) ? field.get(index) : 0.0 );
+    }
+    values.finish();
+  }
+
+  file.finish();
+}
+
+
+
+// arrays of a piece copied out of the mesh, so that the piece can be encoded
+// and written without accessing viennagrid
+struct vtu_piece
+{
+  std::vector<double> points;
+  std::vector<boost::int64_t> connectivity;
+  std::vector<boost::int64_t> offsets;
+  std::vector<boost::uint8_t> types;
+
+  std::vector< std::vector<double> > vertex_values;
+  std::vector< std::vector<double> > cell_values;
+};
+
+template<typename PieceT>
+void extract_piece(PieceT const & piece, vtu_fields const & fields, vtu_piece & result)
+{
+  typedef typename viennagrid::result_of::const_vertex_range<PieceT>::type   VertexRange;
+  typedef typename viennagrid::result_of::iterator<VertexRange>::type        VertexIterator;
+
+  typedef typename viennagrid::result_of::const_cell_range<PieceT>::type     CellRange;
+  typedef typename viennagrid::result_of::iterator<CellRange>::type          CellIterator;
+
+  VertexRange vertices(piece);
+  CellRange cells(piece);
+
+  std::vector<boost::int64_t> local_index;
+  boost::uint64_t vertex_count = number_vertices(piece, local_index);
+
+  result.points.clear();
+  result.points.reserve( 3*vertex_count );
+  for (VertexIterator vit = vertices.begin(); vit != vertices.end(); ++vit)
+  {
+    PointType point = viennagrid::get_point(*vit);
+    for (std::size_t d = 0; d != 3; ++d)
+      result.points.push_back( d < point.size() ? point[d] : 0.0 );
+  }
+
+  result.connectivity.clear();
+  result.offsets.clear();
+  result.types.clear();
+  for (CellIterator cit = cells.begin(); cit != cells.end(); ++cit)
+  {
+    viennagrid_element_type tag = (*cit).tag().internal();
+    result.types.push_back( vtk_cell_type(tag) );
+
+    BoundaryVertexRange cell_vertices(*cit);
+    for (std::size_t i = 0; i != cell_vertices.size(); ++i)
+      result.connectivity.push_back( local_index[ cell_vertices[vtk_vertex_index(tag, i)].id().index() ] );
+    result.offsets.push_back( result.connectivity.size() );
+  }
+
+  result.vertex_values.resize( fields.vertex_fields.size() );
+  for (std::size_t i = 0; i != fields.vertex_fields.size(); ++i)
+  {
+    viennagrid::quantity_field const & field = *fields.vertex_fields[i];
+    result.vertex_values[i].clear();
+    result.vertex_values[i].reserve( vertex_count );
+    for (VertexIterator vit = vertices.begin(); vit != vertices.end(); ++vit)
+    {
+      viennagrid_int index = (*vit).id().index();
+      result.vertex_values[i].push_back( field.valid(index) ? field.get(index) : 0.0 );
+    }
+  }
+
+  result.cell_values.resize( fields.cell_fields.size() );
+  for (std::size_t i = 0; i != fields.cell_fields.size(); ++i)
+  {
+    viennagrid::quantity_field const & field = *fields.cell_fields[i];
+    result.cell_values[i].clear();
+    result.cell_values[i].reserve( result.types.size() );
+    for (CellIterator cit = cells.begin(); cit != cells.end(); ++cit)
+    {
+      viennagrid_int index = (*cit).id().index();
+      result.cell_values[i].push_back( field.valid(index) ? field.get(index) : 0.0 );
+    }
+  }
+}
+
+template<typename T>
+void write_array(appended_vtu_file & file, std::vector<T> const & values)
+{
+  appended_array_writer writer = file.begin_array( values.size()*sizeof(T) );
+  if (!values.empty())
+    writer.write( &values[0], values.size() );
+  writer.finish();
+}
+
+// writes an extracted piece, does not access viennagrid and is thread safe
+void write_extracted_piece(std::string const & filename,
+                 vtu_piece const & piece,
+                 vtu_fields const & fields,
+                 bool compress)
+{
+  appended_vtu_file file(filename, compress);
+  write_vtu_header(file, piece.points.size()/3, piece.types.size(), fields.vertex_field_names, fields.cell_field_names, compress);
+
+  write_array(file, piece.points);
+  write_array(file, piece.connectivity);
+  write_array(file, piece.offsets);
+  write_array(file, piece.types);
+
+  for (std::size_t i = 0; i != piece.vertex_values.size(); ++i)
+    write_array(file, piece.vertex_values[i]);
+  for (std::size_t i = 0; i != piece.cell_values.size(); ++i)
+    write_array(file, piece.cell_values[i]);
+
+  file.finish();
+}
+
+
+// Writes several pieces concurrently. Viennagrid is only accessed serially,
+// thread_count() pieces at a time are copied out of the mesh and their files
+// are then encoded, compressed and written in parallel, which bounds the extra
+// memory to that of one batch.
+template<typename PieceT>
+void write_pieces(std::vector<PieceT> const & pieces,
+                  std::vector<std::string> const & filenames,
+                  vtu_fields const & fields,
+                  bool compress)
+{
+  std::size_t batch_size = thread_count();
+
+  if (batch_size <= 1)
+  {
+    for (std::size_t i = 0; i != pieces.size(); ++i)
+      write_piece(filenames[i], pieces[i], fields, compress);
+    return;
+  }
+
+  std::vector<vtu_piece> batch(batch_size);
+  std::vector<std::string> errors(batch_size);
+
+  for (std::size_t first = 0; first < pieces.size(); first += batch_size)
+  {
+    int count = std::min(batch_size, pieces.size()-first);
+    for (int i = 0; i != count; ++i)
+      extract_piece(pieces[first+i], fields, batch[i]);
+
+#ifdef VIENNAMESH_WITH_OPENMP
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (int i = 0; i < count; ++i)
+    {
+      try
+      {
+        write_extracted_piece(filenames[first+i], batch[i], fields, compress);
+      }
+      catch (vtu_writer_error const & e)
+      {
+        errors[i] = e.what();
+      }
+      catch (std::exception const & e)
+      {
+        errors[i] = "VTU writer: " + std::string(e.what());
+      }
+    }
+
+    for (int i = 0; i != count; ++i)
+    {
+      if (!errors[i].empty())
+        throw viennautils::make_exception<vtu_writer_error>(errors[i]);
+    }
+  }
+}
+
+
+void write_pvd(std::string const & filename,
+               std::vector<std::string> const & parts,
+               std::vector<std::string> const & piece_filenames,
+               std::vector<std::string> const & names)
+{
+  std::ofstream pvd( (filename + ".pvd").c_str() );
+  if (!pvd)
+    throw viennautils::make_exception<vtu_writer_error>("VTU writer: could not open file \"" + filename + ".pvd\" for writing");
+
+  // the pieces are referenced relative to the collection file
+  pvd << "<?xml version=\"1.0\"?>\n";
+  pvd << "<VTKFile type=\"Collection\" version=\"0.1\">\n";
+  pvd << "  <Collection>\n";
+  for (std::size_t i = 0; i != parts.size(); ++i)
+  {
+    pvd << "    <DataSet part=\"" << parts[i] << "\" file=\"" << piece_filenames[i].substr( piece_filenames[i].find_last_of("/\\") + 1 ) << "\"";
+    if (!names[i].empty())
+      pvd << " name=\"" << names[i] << "\"";
+    pvd << "/>\n";
+  }
+  pvd << "  </Collection>\n";
+  pvd << "</VTKFile>\n";
+}
+
+} //end of anonymous namespace
+
+
+
+bool vtu_binary_writer_supports_compression()
+{
+#ifdef VIENNAMESH_WITH_ZLIB
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+void write_to_vtu_binary(std::string const & filename,
+                         viennagrid::const_mesh const & mesh,
+                         std::vector<viennagrid::quantity_field> const & quantities,
+                         bool compress)
+{
+  if (compress && !vtu_binary_writer_supports_compression())
+    throw viennautils::make_exception<vtu_writer_error>("VTU writer: zlib compression requested but not available");
+
+  int cell_dimension = viennagrid::topologic_dimension(mesh);
+
+  vtu_fields fields;
+  for (std::size_t i = 0; i != quantities.size(); ++i)
+  {
+    if (quantities[i].values_per_quantity() != 1)
+      continue;
+
+    if (quantities[i].topologic_dimension() == 0)
+    {
+      fields.vertex_fields.push_back( &quantities[i] );
+      fields.vertex_field_names.push_back( quantities[i].get_name() );
+    }
+    else if (quantities[i].topologic_dimension() == cell_dimension)
+    {
+      fields.cell_fields.push_back( &quantities[i] );
+      fields.cell_field_names.push_back( quantities[i].get_name() );
+    }
+  }
+
+  if (mesh.region_count() <= 1)
+  {
+    write_piece(filename + ".vtu", mesh, fields, compress);
+    return;
+  }
+
+  std::vector<RegionType> regions;
+  std::vector<std::string> parts;
+  std::vector<std::string> piece_filenames;
+  std::vector<std::string> names;
+
+  RegionRange region_range(mesh);
+  for (RegionIterator rit = region_range.begin(); rit != region_range.end(); ++rit)
+  {
+    std::string region_id = boost::lexical_cast<std::string>( (*rit).id() );
+
+    regions.push_back( *rit );
+    parts.push_back( region_id );
+    piece_filenames.push_back( filename + "_" + region_id + ".vtu" );
+    names.push_back( (*rit).get_name() );
+  }
+
+  write_pieces(regions, piece_filenames, fields, compress);
+  write_pvd(filename, parts, piece_filenames, names);
+}
+
+
+void write_to_vtu_binary(std::string const & filename,
+                         std::vector<viennagrid::mesh> const & meshes,
+                         bool compress)
+{
+  if (compress && !vtu_binary_writer_supports_compression())
+    throw viennautils::make_exception<vtu_writer_error>("VTU writer: zlib compression requested but not available");
+
+  std::vector<MeshType> pieces;
+  std::vector<std::string> parts;
+  std::vector<std::string> piece_filenames;
+
+  for (std::size_t i = 0; i != meshes.size(); ++i)
+  {
+    std::string index = boost::lexical_cast<std::string>(i);
+
+    pieces.push_back( meshes[i] );
+    parts.push_back( index );
+    piece_filenames.push_back( filename + "_" + index + ".vtu" );
+  }
+
+  write_pieces(pieces, piece_filenames, vtu_fields(), compress);
+  write_pvd(filename, parts, piece_filenames, std::vector<std::string>(meshes.size()));
+}
+
+} //end of namespace viennamesh
@@ -0,0 +1,57 @@
+#ifndef VIENNAMESH_ALGORITHM_IO_VTU_BINARY_WRITER_HPP
+#define VIENNAMESH_ALGORITHM_IO_VTU_BINARY_WRITER_HPP
+
+/* ============================================================================
+   Copyright (c) 2011-2014, Institute for Microelectronics,
+                            Institute for Analysis and Scientific Computing,
+                            TU Wien.
+
+                            -----------------
+                ViennaMesh - The Vienna Meshing Framework
+                            -----------------
+
+                    http://viennamesh.sourceforge.net/
+
+   License:         MIT (X11), see file LICENSE in the base directory
+=============================================================================== */
+
+#include <string>
+#include <vector>
+
+#include "viennautils/exception.hpp"
+
+#include "viennagrid/mesh/mesh.hpp"
+#include "viennagrid/core/quantity_field.hpp"
+
+namespace viennamesh
+{
+
+struct vtu_writer_error : virtual viennautils::exception {};
+
+// Writes a mesh as VTK XML unstructured grid with all arrays in a raw appended
+// data section, zlib compressed in blocks if compress is set. The arrays are
+// streamed to the file while iterating the mesh, no intermediate text or array
+// buffers are built. A mesh with more than one region is written as
+// <filename>.pvd with one piece <filename>_<region id>.vtu per region, the
+// pieces are written concurrently and the collection file last. Otherwise the
+// mesh is written as <filename>.vtu. Scalar quantity fields on vertices and
+// cells are written as point and cell data, all other quantity fields are
+// ignored.
+void write_to_vtu_binary(std::string const & filename,
+                         viennagrid::const_mesh const & mesh,
+                         std::vector<viennagrid::quantity_field> const & quantities,
+                         bool compress);
+
+// Writes each mesh, e.g. a partition of metis_mesh_partitioning, as piece
+// <filename>_<index>.vtu and all of them as collection <filename>.pvd. The
+// pieces are written concurrently.
+void write_to_vtu_binary(std::string const & filename,
+                         std::vector<viennagrid::mesh> const & meshes,
+                         bool compress);
+
+// true if the binary VTU writer was built with zlib compression support
+bool vtu_binary_writer_supports_compression();
+
+} //end of namespace viennamesh
+
+#endif
@@ -13,11 +13,229 @@
 =============================================================================== */
 
 #include "merge_close_points.hpp"
-#include "viennagrid/core/ntree.hpp"
-#include "viennagrid/algorithm/geometry.hpp"
+#include "viennameshpp/parallel.hpp"
+#include "viennameshpp/union_find.hpp"
+
+#include <cmath>
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
 
 namespace viennamesh
 {
+  namespace
+  {
+    typedef boost::uint64_t morton_code;
+
+    // spreads the lower 21 bits of x so that two zero bits are between each bit
+    morton_code spread_bits(morton_code x)
+    {
+      x &= UINT64_C(0x1fffff);
+      x = (x | x << 32) & UINT64_C(0x1f00000000ffff);
+      x = (x | x << 16) & UINT64_C(0x1f0000ff0000ff);
+      x = (x | x << 8)  & UINT64_C(0x100f00f00f00f00f);
+      x = (x | x << 4)  & UINT64_C(0x10c30c30c30c30c3);
+      x = (x | x << 2)  & UINT64_C(0x1249249249249249);
+      return x;
+    }
+
+    morton_code make_morton_code(long const * cell)
+    {
+      return spread_bits(cell[0]) | (spread_bits(cell[1]) << 1) | (spread_bits(cell[2]) << 2);
+    }
+
+    long const max_grid_coordinate = (1l << 21) - 1;
+
+    struct morton_entry
+    {
+      morton_code code;
+      viennagrid_int index;
+
+      bool operator<(morton_entry const & other) const
+      {
+        return code < other.code || (code == other.code && index < other.index);
+      }
+    };
+
+
+    // vertices bucketed in a uniform grid with cell size >= merge distance, the grid cells
+    // are stored sorted by their Morton code, so all vertices of a grid cell are contiguous
+    class morton_point_grid
+    {
+    public:
+
+      morton_point_grid(std::vector<viennagrid_numeric> const & coords_, int geometric_dimension_, double merge_distance) :
+          coords(coords_), geometric_dimension(geometric_dimension_)
+      {
+        viennagrid_int vertex_count = coords.size() / geometric_dimension;
+
+        double max_extent = 0;
+        for (int d = 0; d != geometric_dimension; ++d)
+        {
+          min[d] = max[d] = coords[d];
+          for (viennagrid_int i = 1; i < vertex_count; ++i)
+          {
+            min[d] = std::min(min[d], coords[i*geometric_dimension+d]);
+            max[d] = std::max(max[d], coords[i*geometric_dimension+d]);
+          }
+          max_extent = std::max(max_extent, max[d]-min[d]);
+        }
+
+        cell_size = std::max( merge_distance, max_extent / (max_grid_coordinate-1) );
+        if (cell_size <= 0)
+          cell_size = 1.0;
+
+        entries.resize(vertex_count);
+
+#ifdef VIENNAMESH_WITH_OPENMP
+        #pragma omp parallel for
+#endif
+        for (viennagrid_int i = 0; i < vertex_count; ++i)
+        {
+          long cell[3];
+          grid_cell( &coords[i*geometric_dimension], cell );
+          entries[i].code = make_morton_code(cell);
+          entries[i].index = i;
+        }
+
+        parallel_sort( entries.begin(), entries.end() );
+      }
+
+      // calls functor(j) for every vertex j in the grid cells around point p
+      template<typename FunctorT>
+      void for_each_candidate(viennagrid_numeric const * p, FunctorT & functor) const
+      {
+        long center[3];
+        grid_cell(p, center);
+
+        long range[3];
+        for (int d = 0; d != 3; ++d)
+          range[d] = (d < geometric_dimension) ? 1 : 0;
+
+        long cell[3];
+        for (long i = -range[0]; i <= range[0]; ++i)
+          for (long j = -range[1]; j <= range[1]; ++j)
+            for (long k = -range[2]; k <= range[2]; ++k)
+            {
+              cell[0] = center[0]+i;
+              cell[1] = center[1]+j;
+              cell[2] = center[2]+k;
+
+              if (cell[0] < 0 || cell[1] < 0 || cell[2] < 0 ||
+                  cell[0] > max_grid_coordinate || cell[1] > max_grid_coordinate || cell[2] > max_grid_coordinate)
+                continue;
+
+              morton_entry key;
+              key.code = make_morton_code(cell);
+              key.index = 0;
+
+              for (std::vector<morton_entry>::const_iterator it = std::lower_bound(entries.begin(), entries.end(), key);
+                   it != entries.end() && (*it).code == key.code; ++it)
+                functor( (*it).index );
+            }
+      }
+
+    private:
+
+      void grid_cell(viennagrid_numeric const * p, long * cell) const
+      {
+        for (int d = 0; d != 3; ++d)
+          cell[d] = (d < geometric_dimension) ? static_cast<long>(std::floor((p[d]-min[d]) / cell_size)) : 0;
+      }
+
+      std::vector<viennagrid_numeric> const & coords;
+      int geometric_dimension;
+
+      double min[3];
+      double max[3];
+      double cell_size;
+
+      std::vector<morton_entry> entries;
+    };
+
+
+    // disjoint set forest over the vertices one thread has seen in close pairs,
+    // vertices without an entry are the representatives of their own set
+    class sparse_union_find
+    {
+    public:
+
+      viennagrid_int find(viennagrid_int index)
+      {
+        ParentMapType::iterator it = parents.find(index);
+        while (it != parents.end())
+        {
+          // path halving
+          ParentMapType::iterator parent = parents.find(it->second);
+          if (parent != parents.end())
+            it->second = parent->second;
+
+          index = it->second;
+          it = parents.find(index);
+        }
+        return index;
+      }
+
+      bool unite(viennagrid_int lhs, viennagrid_int rhs)
+      {
+        lhs = find(lhs);
+        rhs = find(rhs);
+
+        if (lhs == rhs)
+          return false;
+
+        if (lhs < rhs)
+          parents[rhs] = lhs;
+        else
+          parents[lhs] = rhs;
+
+        return true;
+      }
+
+    private:
+      typedef boost::unordered_map<viennagrid_int, viennagrid_int> ParentMapType;
+      ParentMapType parents;
+    };
+
+
+    // A close pair is only stored if it joins two sets of the pairs its thread
+    // found so far, the stored pairs form a spanning forest of them. A cluster of
+    // k coincident points is stored as k-1 pairs instead of k*(k-1)/2.
+    struct close_point_collector
+    {
+      close_point_collector(std::vector<viennagrid_numeric> const & coords_, int geometric_dimension_, double merge_distance_,
+                            viennagrid_int index_, sparse_union_find & sets_,
+                            std::vector< std::pair<viennagrid_int, viennagrid_int> > & pairs_) :
+          coords(coords_), geometric_dimension(geometric_dimension_), merge_distance(merge_distance_), index(index_),
+          sets(sets_), pairs(pairs_) {}
+
+      void operator()(viennagrid_int other)
+      {
+        // every pair is only reported by its smaller index
+        if (other <= index)
+          return;
+
+        double distance = 0;
+        for (int d = 0; d != geometric_dimension; ++d)
+        {
+          double tmp = coords[index*geometric_dimension+d] - coords[other*geometric_dimension+d];
+          distance += tmp*tmp;
+        }
+
+        if (std::sqrt(distance) < merge_distance && sets.unite(index, other))
+          pairs.push_back( std::make_pair(index, other) );
+      }
+
+      std::vector<viennagrid_numeric> const & coords;
+      int geometric_dimension;
+      double merge_distance;
+      viennagrid_int index;
+      sparse_union_find & sets;
+      std::vector< std::pair<viennagrid_int, viennagrid_int> > & pairs;
+    };
+  }
+
+
+
   merge_close_points::merge_close_points() {}
   std::string merge_close_points::name() { return "merge_close_points"; }
 
@@ -38,68 +256,66 @@ namespace viennamesh
     ConstElementRangeType vertices( input_mesh(), 0 );
     info(1) << "Old vertex count = " << vertices.size() << std::endl;
 
+    int geometric_dimension = viennagrid::geometric_dimension( input_mesh() );
+    viennagrid_int vertex_count = vertices.size();
 
-//     OLD IMPLEMENTATION
-//
-//     std::vector<ElementType> new_vertices;
-//     for (ConstElementIteratorType vit = vertices.begin(); vit != vertices.end(); ++vit)
-//     {
-//       PointType p = viennagrid::get_point(*vit);
-//
-//       std::vector<ElementType>::iterator nvit = new_vertices.begin();
-//       for (; nvit != new_vertices.end(); ++nvit)
-//       {
-//         if (viennagrid::norm_2(p - viennagrid::get_point(*nvit)) < merge_distance )
-//         {
-//           new_vertices.push_back(*nvit);
-//           break;
-//         }
-//       }
-//
-//       if (nvit == new_vertices.end())
-//         new_vertices.push_back( viennagrid::make_vertex(output_mesh(), p) );
-//     }
-
-
-    // build up ntree
-    std::pair<PointType, PointType> bb = viennagrid::bounding_box( input_mesh() );
-    PointType center = (bb.first + bb.second)/2;
-    PointType size = bb.second - bb.first;
-
-    typedef viennagrid::vertex_with_distance_wrapper<ElementType> WrapperType;
-    typedef viennagrid::ntree_node<WrapperType> NodeType;
-    boost::shared_ptr<NodeType> root( new NodeType( center-size/2*1.1 , center+size/2*1.1 ) );
-
-    int element_per_node = 10;
-    for (ConstElementIteratorType vit = vertices.begin(); vit != vertices.end(); ++vit)
-      root->add( WrapperType(*vit, merge_distance),
-                 element_per_node,
-                 vertices.size()/element_per_node);
+    if (vertex_count == 0 || geometric_dimension > 3)
+    {
+      viennagrid::copy( input_mesh(), output_mesh() );
+      set_output( "mesh", output_mesh );
+      return true;
+    }
 
-    // create new vertices
-    viennagrid::vector<ElementType> new_vertices( vertices.size() );
+    std::vector<viennagrid_numeric> coords( vertex_count * geometric_dimension );
     for (ConstElementIteratorType vit = vertices.begin(); vit != vertices.end(); ++vit)
     {
       PointType p = viennagrid::get_point(*vit);
+      for (int d = 0; d != geometric_dimension; ++d)
+        coords[(*vit).id().index()*geometric_dimension + d] = p[d];
+    }
+
+    morton_point_grid grid( coords, geometric_dimension, merge_distance );
+
+    // query all close point pairs concurrently, each thread only keeps the pairs
+    // which connect its own sets
+    std::vector< std::vector< std::pair<viennagrid_int, viennagrid_int> > > thread_pairs( thread_count() );
+    std::vector<sparse_union_find> thread_sets( thread_count() );
+
+#ifdef VIENNAMESH_WITH_OPENMP
+    #pragma omp parallel for schedule(dynamic, 1024)
+#endif
+    for (viennagrid_int i = 0; i < vertex_count; ++i)
+    {
+      close_point_collector collector( coords, geometric_dimension, merge_distance, i,
+                                       thread_sets[thread_id()], thread_pairs[thread_id()] );
+      grid.for_each_candidate( &coords[i*geometric_dimension], collector );
+    }
+
+    // merge groups are the connected components of the close point pairs,
+    // each group is represented by its vertex with the smallest index
+    std::vector<sparse_union_find>().swap(thread_sets);
+    union_find<viennagrid_int> merge_groups(vertex_count);
+    for (std::size_t t = 0; t != thread_pairs.size(); ++t)
+    {
+      for (std::size_t i = 0; i != thread_pairs[t].size(); ++i)
+        merge_groups.unite( thread_pairs[t][i].first, thread_pairs[t][i].second );
+      std::vector< std::pair<viennagrid_int, viennagrid_int> >().swap(thread_pairs[t]);
+    }
 
-      viennagrid::element_id new_vertex_id = (*vit).id();
-      NodeType * node = root->get(p);
-      for (std::size_t i = 0; i != node->elements().size(); ++i)
+    // create new vertices
+    std::vector<ElementType> new_vertices( vertex_count );
+    PointType p(geometric_dimension);
+    for (viennagrid_int i = 0; i != vertex_count; ++i)
+    {
+      viennagrid_int representative = merge_groups.find(i);
+      if (representative == i)
       {
-        if (viennagrid::norm_2(p - viennagrid::get_point(node->elements()[i]())) < merge_distance )
-        {
-          if ( node->elements()[i]().id() < new_vertex_id )
-          {
-            new_vertex_id = node->elements()[i]().id();
-            break;
-          }
-        }
+        for (int d = 0; d != geometric_dimension; ++d)
+          p[d] = coords[i*geometric_dimension + d];
+        new_vertices[i] = viennagrid::make_vertex(output_mesh(), p);
       }
-
-      if ( new_vertex_id == (*vit).id() )
-        new_vertices[(*vit).id()] = viennagrid::make_vertex(output_mesh(), p);
       else
-        new_vertices[(*vit).id()] = new_vertices[new_vertex_id];
+        new_vertices[i] = new_vertices[representative];
     }
 
     // create cell for new mesh using merged vertices
@@ -113,7 +329,7 @@ namespace viennamesh
 
       ConstCoundaryRangeType boundary_vertices(*cit, 0);
       for (ConstCoundaryIteratorType bvit = boundary_vertices.begin(); bvit != boundary_vertices.end(); ++bvit)
-        local_vertices.push_back( new_vertices[(*bvit).id()] );
+        local_vertices.push_back( new_vertices[(*bvit).id().index()] );
 
       viennagrid::make_element( output_mesh(), (*cit).tag(), local_vertices.begin(), local_vertices.end() );
     }
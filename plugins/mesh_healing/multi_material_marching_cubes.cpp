@@ -126,10 +126,14 @@ namespace viennamesh
 
   struct poly_line
   {
-    std::vector<int> vertex_indices;
+    poly_line(arena_allocator<int> const & allocator) : vertex_indices(allocator) {}
+
+    std::vector<int, arena_allocator<int> > vertex_indices;
     std::pair<int,int> regions;
   };
 
+  typedef std::vector< poly_line, arena_allocator<poly_line> > poly_line_container;
+
 
   struct marching_cube
   {
@@ -156,14 +160,17 @@ namespace viennamesh
 
 
 //     void make_lines(std::map<int,int> & region_priority)
-    void make_lines(std::vector<int> const & region_priority)
+    void make_lines(std::vector<int> const & region_priority,
+                    arena_allocator<int> const & allocator)
     {
+      typedef std::map< int, int, std::less<int>, arena_allocator< std::pair<const int, int> > > RegionCountMapType;
+
       for (int f = 0; f != 6; ++f)
       {
         marching_square & face = faces[f];
 
         int local_region[4];
-        std::map<int, int> regions;
+        RegionCountMapType regions( std::less<int>(), allocator );
 
         for (int i = 0; i != 4; ++i)
         {
@@ -177,7 +184,7 @@ namespace viennamesh
 
         if (regions.size() == 2)
         {
-          std::map<int, int>::iterator it = regions.begin();
+          RegionCountMapType::iterator it = regions.begin();
           int region_id0 = it->first;
           int region_count0 = it->second;
 
@@ -398,9 +405,9 @@ namespace viennamesh
     }
 
 
-    std::vector<poly_line> make_poly_lines()
+    poly_line_container make_poly_lines(arena_allocator<int> const & allocator)
     {
-      std::vector<poly_line> poly_lines;
+      poly_line_container poly_lines(allocator);
 
       if (face_centers < 0 || face_centers == 1)
       {
@@ -432,7 +439,7 @@ namespace viennamesh
             if (center_lines_visited[f][cl])
               continue;
 
-            poly_line pl;
+            poly_line pl(allocator);
             if (face_centers > 2)
               pl.vertex_indices.push_back( 18 );
             pl.vertex_indices.push_back( 12+f );
@@ -496,7 +503,7 @@ namespace viennamesh
         if (edge_lines[e].empty())
           continue;
 
-        poly_line pl;
+        poly_line pl(allocator);
         pl.regions = line_regions( edge_lines[e][0] );
 
         int cur_edge = e;
@@ -593,6 +600,7 @@ namespace viennamesh
     data_handle<int> size_add = get_required_input<int>("size_add");
     data_handle<double> region_scale = get_required_input<double>("region_scale");
     data_handle<double> is_inside_tolerance = get_required_input<double>("is_inside_tolerance");
+    data_handle<bool> use_scratch_arena = get_input<bool>("use_scratch_arena");
 
     typedef viennagrid::result_of::element_range<MeshType>::type ElementRangeType;
     typedef viennagrid::result_of::iterator<ElementRangeType>::type ElementIteratorType;
@@ -643,7 +651,7 @@ namespace viennamesh
     for (RegionIteratorType rit = regions.begin(); rit != regions.end(); ++rit)
       max_region_id = std::max((*rit).id(), max_region_id);
 
-    std::vector<int> region_priority(max_region_id);
+    std::vector<int> region_priority(max_region_id+1);
 
     int counter = region_count;
     for (RegionIteratorType rit = regions.begin(); rit != regions.end(); ++rit)
@@ -741,6 +749,10 @@ namespace viennamesh
 
     std::vector<char> & used_samples = sample_regions;
 
+    // region counts and poly lines of a cube are scratch data
+    bool use_arena = !use_scratch_arena.valid() || use_scratch_arena();
+    arena_allocator<int> scratch_allocator( use_arena ? &scratch_arena() : 0 );
+
     for (int z = -sample_count[2]/2; z < sample_count[2]/2; ++z)
       for (int y = -sample_count[1]/2; y < sample_count[1]/2; ++y)
         for (int x = -sample_count[0]/2; x < sample_count[0]/2; ++x)
@@ -758,9 +770,11 @@ namespace viennamesh
             continue;
 
 
+          arena_scope cube_scope( scratch_arena() );
+
           marching_cube mc(r0, r1, r2, r3, r4, r5, r6, r7);
-          mc.make_lines(region_priority);
-          std::vector<poly_line> poly_lines = mc.make_poly_lines();
+          mc.make_lines(region_priority, scratch_allocator);
+          poly_line_container poly_lines = mc.make_poly_lines(scratch_allocator);
 
           PointType p[8];
           p[0] = viennagrid::make_point( sample_size[0] *  x,    sample_size[1] *  y,    sample_size[2] * z     );
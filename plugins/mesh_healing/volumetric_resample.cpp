@@ -137,6 +137,7 @@ namespace viennamesh
   bool volumetric_resample::run(viennamesh::algorithm_handle &)
   {
     data_handle<int> sample_count = get_required_input<int>("sample_count");
+    data_handle<bool> use_scratch_arena = get_input<bool>("use_scratch_arena");
 
     mesh_handle reference_mesh = get_required_input<mesh_handle>("reference_mesh");
     mesh_handle base_mesh = get_required_input<mesh_handle>("base_mesh");
@@ -165,20 +166,30 @@ namespace viennamesh
     RegionAccessor region(region_container);
 
 
+    // the per cell weights and per sample hit counts are scratch data
+    bool use_arena = !use_scratch_arena.valid() || use_scratch_arena();
+    arena_allocator<double> scratch_allocator( use_arena ? &scratch_arena() : 0 );
+
+    typedef std::vector<double, arena_allocator<double> > WeightContainerType;
+    typedef std::vector<int, arena_allocator<int> > HitContainerType;
 
     for (CellRangeIterator cit = cells.begin(); cit != cells.end(); ++cit)
     {
       if ( region.get(*cit) != NOT_SPECIFIED )
         continue;
 
+      arena_scope cell_scope( scratch_arena() );
+
       point pt_a = viennagrid::get_point( viennagrid::vertices(*cit)[0] );
       point pt_b = viennagrid::get_point( viennagrid::vertices(*cit)[1] );
       point pt_c = viennagrid::get_point( viennagrid::vertices(*cit)[2] );
       point pt_d = viennagrid::get_point( viennagrid::vertices(*cit)[3] );
 
-      std::vector<double> weights(region_count+1, 0.0);
+      WeightContainerType weights(region_count+1, 0.0, scratch_allocator);
       for (int i = 0; i < sample_count(); ++i)
       {
+        arena_scope sample_scope( scratch_arena() );
+
         double a = -1;
         double b = -1;
         double c = -1;
@@ -194,7 +205,7 @@ namespace viennamesh
 
         point sample_point = (a*pt_a + b*pt_b + c*pt_c + d*pt_d) / (a+b+c+d);
 
-        std::vector<int> local_hits(region_count, 0);
+        HitContainerType local_hits(region_count, 0, scratch_allocator);
         int total_local_hits = 0;
 
         CellRangeType src_cells( reference_mesh() );
@@ -224,7 +235,7 @@ namespace viennamesh
         }
       }
 
-      std::vector<double>::iterator max = std::max_element( weights.begin(), weights.end() );
+      WeightContainerType::iterator max = std::max_element( weights.begin(), weights.end() );
       int region_id = max - weights.begin();
 
       if (*max > 0.9*sample_count() && region_id != region_count)
@@ -38,6 +38,7 @@ namespace viennamesh
     typedef viennagrid::result_of::iterator<ConstCellRangeType>::type       ConstCellRangeIterator;
 
     typedef viennagrid::result_of::element<MeshType>::type                  ElementType;
+    typedef viennagrid::result_of::const_element<MeshType>::type            ConstElementType;
     typedef viennagrid::result_of::const_element_range<ElementType>::type   ConstElementRangeType;
     typedef viennagrid::result_of::iterator<ConstElementRangeType>::type    ConstElementRangeIterator;
 
@@ -92,17 +93,27 @@ namespace viennamesh
     if ( multi_mesh_output.valid() && multi_mesh_output() )
     {
       output_mesh.resize( region_count() );
-      std::vector<ElementCopyMapType> copy_maps;
 
+      // bucket the cells by partition in one pass, the cells of partition i
+      // are part_cells[part_offsets[i] .. part_offsets[i+1])
+      std::vector<std::size_t> part_offsets( region_count()+1, 0 );
+      for (ConstCellRangeIterator cit = cells.begin(); cit != cells.end(); ++cit)
+        ++part_offsets[ epart[(*cit).id().index()]+1 ];
       for (int i = 0; i != region_count(); ++i)
+        part_offsets[i+1] += part_offsets[i];
+
+      std::vector<ConstElementType> part_cells( part_offsets.back() );
       {
-        ElementCopyMapType copy_map( output_mesh(i) );
+        std::vector<std::size_t> next( part_offsets.begin(), part_offsets.end()-1 );
         for (ConstCellRangeIterator cit = cells.begin(); cit != cells.end(); ++cit)
-        {
-          int part = epart[(*cit).id().index()];
-          if (part == i)
-            copy_map( *cit );
-        }
+          part_cells[ next[epart[(*cit).id().index()]]++ ] = *cit;
+      }
+
+      for (int i = 0; i != region_count(); ++i)
+      {
+        ElementCopyMapType copy_map( output_mesh(i) );
+        for (std::size_t j = part_offsets[i]; j != part_offsets[i+1]; ++j)
+          copy_map( part_cells[j] );
       }
     }
     else
@@ -24,6 +24,114 @@ namespace viennamesh
 {
   namespace netgen
   {
+    // copies the surface elements bounding domain into domain_mesh (as domain 1), the
+    // points of domain_mesh are added in the order of local_to_global
+    void extract_domain_surface(netgen::mesh const & mesh, int domain,
+                                netgen::mesh & domain_mesh,
+                                std::vector<int> & local_to_global)
+    {
+      std::vector<int> global_to_local( mesh.GetNP()+1, 0 );
+      domain_mesh.AddFaceDescriptor( ::netgen::FaceDescriptor(1, 1, 0, 1) );
+
+      for (int i = 1; i <= mesh.GetNSE(); ++i)
+      {
+        ::netgen::Element2d const & element = mesh.SurfaceElement(i);
+        if (element.IsDeleted())
+          continue;
+
+        ::netgen::FaceDescriptor const & face_descriptor = mesh.GetFaceDescriptor( element.GetIndex() );
+        bool inside = face_descriptor.DomainIn() == domain;
+        bool outside = face_descriptor.DomainOut() == domain;
+        if (inside == outside)
+          continue;
+
+        ::netgen::Element2d domain_element( element.GetNP() );
+        domain_element.SetIndex(1);
+        for (int j = 1; j <= element.GetNP(); ++j)
+        {
+          int global_index = element.PNum(j);
+          if (global_to_local[global_index] == 0)
+          {
+            ::netgen::MeshPoint const & p = mesh.Point(global_index);
+            global_to_local[global_index] = domain_mesh.AddPoint( ::netgen::Point3d(p[0], p[1], p[2]) );
+            local_to_global.push_back(global_index);
+          }
+          domain_element.PNum(j) = global_to_local[global_index];
+        }
+
+        // the domain has to be on the inner side of all its boundary elements
+        if (outside)
+          domain_element.Invert();
+
+        domain_mesh.AddSurfaceElement(domain_element);
+      }
+    }
+
+
+    bool mesh_volume(netgen::mesh & mesh, ::netgen::MeshingParameters & mesh_parameters, std::string & error_message)
+    {
+      try
+      {
+        mesh.CalcLocalH(mesh_parameters.grading);
+        MeshVolume (mesh_parameters, mesh);
+        RemoveIllegalElements (mesh);
+        OptimizeVolume (mesh_parameters, mesh);
+      }
+      catch (::netgen::NgException const & ex)
+      {
+        error_message = ex.What();
+        return false;
+      }
+
+      return true;
+    }
+
+
+    // adds the volume elements of domain_mesh to mesh as domain, the surface points
+    // of domain_mesh are its first points and are mapped back using local_to_global
+    bool add_domain_volume(netgen::mesh const & domain_mesh, int domain,
+                           std::vector<int> const & local_to_global,
+                           netgen::mesh & mesh)
+    {
+      int surface_point_count = local_to_global.size();
+      std::vector<int> local_to_global_all( domain_mesh.GetNP()+1, 0 );
+
+      for (int i = 1; i <= surface_point_count && i <= domain_mesh.GetNP(); ++i)
+      {
+        ::netgen::MeshPoint const & local = domain_mesh.Point(i);
+        ::netgen::MeshPoint const & global = mesh.Point(local_to_global[i-1]);
+        if (local[0] != global[0] || local[1] != global[1] || local[2] != global[2])
+          return false;
+
+        local_to_global_all[i] = local_to_global[i-1];
+      }
+
+      for (int i = 1; i <= domain_mesh.GetNE(); ++i)
+      {
+        ::netgen::Element element = domain_mesh.VolumeElement(i);
+        if (element.IsDeleted())
+          continue;
+
+        for (int j = 1; j <= element.GetNP(); ++j)
+        {
+          int local_index = element.PNum(j);
+          if (local_to_global_all[local_index] == 0)
+          {
+            ::netgen::MeshPoint const & p = domain_mesh.Point(local_index);
+            local_to_global_all[local_index] = mesh.AddPoint( ::netgen::Point3d(p[0], p[1], p[2]) );
+          }
+          element.PNum(j) = local_to_global_all[local_index];
+        }
+
+        element.SetIndex(domain);
+        mesh.AddVolumeElement(element);
+      }
+
+      return true;
+    }
+
+
+
     make_mesh::make_mesh() {}
 
     std::string make_mesh::name() { return "netgen_make_mesh"; }
@@ -32,6 +140,7 @@ namespace viennamesh
     {
       data_handle<netgen::mesh> input_mesh = get_input<netgen::mesh>("mesh");
       data_handle<double> cell_size = get_input<double>("cell_size");
+      data_handle<bool> separate_domains = get_input<bool>("separate_domains");
 
       data_handle<netgen::mesh> output_mesh = make_data<netgen::mesh>();
       netgen::mesh & mesh = const_cast<netgen::mesh&>(output_mesh());
@@ -69,17 +178,43 @@ namespace viennamesh
         mesh_parameters.maxh = cell_size();
       }
 
-      try
+      int domain_count = mesh.GetNDomains();
+      if ( separate_domains.valid() && separate_domains() && domain_count > 1 )
       {
-        mesh.CalcLocalH(mesh_parameters.grading);
-        MeshVolume (mesh_parameters, mesh);
-        RemoveIllegalElements (mesh);
-        OptimizeVolume (mesh_parameters, mesh);
+        info(1) << "Meshing " << domain_count << " domains separately" << std::endl;
+
+        // The surface meshes are fixed, so interfaces are meshed identically from
+        // both sides. The bundled netgen keeps its status, profiling and rule
+        // state in process-wide variables, the domains are meshed one after another.
+        for (int k = 1; k <= domain_count; ++k)
+        {
+          netgen::mesh domain_mesh;
+          std::vector<int> local_to_global;
+          extract_domain_surface( mesh, k, domain_mesh, local_to_global );
+
+          ::netgen::MeshingParameters domain_mesh_parameters = mesh_parameters;
+          std::string error_message;
+          if (!mesh_volume( domain_mesh, domain_mesh_parameters, error_message ))
+          {
+            error(1) << "Netgen Error in domain " << k << ": " << error_message << std::endl;
+            return false;
+          }
+
+          if (!add_domain_volume( domain_mesh, k, local_to_global, mesh ))
+          {
+            error(1) << "Netgen changed the surface mesh of domain " << k << std::endl;
+            return false;
+          }
+        }
       }
-      catch (::netgen::NgException const & ex)
+      else
       {
-        error(1) << "Netgen Error: " << ex.What() << std::endl;
-        return false;
+        std::string error_message;
+        if (!mesh_volume( mesh, mesh_parameters, error_message ))
+        {
+          error(1) << "Netgen Error: " << error_message << std::endl;
+          return false;
+        }
       }
 
       set_output("mesh", output_mesh);
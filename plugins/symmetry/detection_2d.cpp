@@ -15,6 +15,7 @@
 #include <set>
 #include <map>
 #include <iterator>
+#include <algorithm>
 
 #include "detection_2d.hpp"
 #include "viennagrid/algorithm/volume.hpp"
@@ -78,48 +79,147 @@ namespace viennamesh
     return a;
   }
 
-  template<typename ContainerT>
-  typename ContainerT::value_type const & cyclic_access(ContainerT const & container, int index)
+  // Maps the values of a symmetry string to symbols, values which are equal
+  // with respect to nc share a symbol. Symbols are non-negative.
+  template<typename NumericConfigT>
+  std::vector<int> string_symbols(std::vector<double> const & values, NumericConfigT nc)
   {
-    index = index % container.size();
+    std::vector< std::pair<double, std::size_t> > sorted_values( values.size() );
+    for (std::size_t i = 0; i != values.size(); ++i)
+      sorted_values[i] = std::make_pair( values[i], i );
+    std::sort( sorted_values.begin(), sorted_values.end() );
+
+    std::vector<int> symbols( values.size() );
+    int symbol = -1;
+    double symbol_value = 0.0;
+    for (std::size_t i = 0; i != sorted_values.size(); ++i)
+    {
+      if (symbol == -1 || !viennagrid::detail::is_equal(nc, symbol_value, sorted_values[i].first))
+      {
+        ++symbol;
+        symbol_value = sorted_values[i].first;
+      }
 
-    if (index < 0)
-      index += container.size();
+      symbols[ sorted_values[i].second ] = symbol;
+    }
 
-    return container[index];
+    return symbols;
   }
 
 
-
-  template<typename ContainerT, typename NumericConfigT>
-  bool is_palindrome(ContainerT const & container, int rotate, NumericConfigT nc)
+  // z[i] is the length of the longest common prefix of string and its suffix
+  // starting at i, z[0] is the string size
+  inline std::vector<int> z_function(std::vector<int> const & string)
   {
-    for (int i = 0; i != container.size()/2; ++i)
+    int size = string.size();
+    std::vector<int> z(size, 0);
+    if (size == 0)
+      return z;
+
+    z[0] = size;
+    for (int i = 1, left = 0, right = 0; i < size; ++i)
     {
-      int i0 = i+rotate;
-      int i1 = container.size()-1-i+rotate;
+      if (i < right)
+        z[i] = std::min(right-i, z[i-left]);
 
-      if (!viennagrid::detail::is_equal(nc, cyclic_access(container, i0), cyclic_access(container, i1)))
-        return false;
+      while (i+z[i] < size && string[z[i]] == string[i+z[i]])
+        ++z[i];
+
+      if (i+z[i] > right)
+      {
+        left = i;
+        right = i+z[i];
+      }
     }
 
-    return true;
+    return z;
+  }
+
+  // for each position of text, the length of the longest common prefix of
+  // pattern and the text starting there, symbols have to be non-negative
+  inline std::vector<int> prefix_matches(std::vector<int> const & pattern, std::vector<int> const & text)
+  {
+    std::vector<int> string(pattern);
+    string.push_back(-1);
+    string.insert( string.end(), text.begin(), text.end() );
+
+    std::vector<int> z = z_function(string);
+    return std::vector<int>( z.begin() + pattern.size() + 1, z.end() );
   }
 
 
-  template<typename ContainerT, typename NumericConfigT>
-  bool is_equal(ContainerT const & container, int rotate, NumericConfigT nc)
+  // smallest rotation of a cyclic string which maps the string onto itself,
+  // every rotation mapping the string onto itself is a multiple of it
+  inline std::size_t cyclic_period(std::vector<int> const & symbols)
   {
-    for (std::size_t i = 0; i != container.size(); ++i)
+    std::vector<int> z = z_function(symbols);
+    for (std::size_t period = 1; period < symbols.size(); ++period)
     {
-      std::size_t  i0 = i;
-      std::size_t  i1 = i+rotate;
+      if (symbols.size() % period == 0 && z[period] == static_cast<int>(symbols.size()-period))
+        return period;
+    }
 
-      if (!viennagrid::detail::is_equal(nc, cyclic_access(container, i0), cyclic_access(container, i1)))
-        return false;
+    return symbols.size();
+  }
+
+
+  struct identity_mirror
+  {
+    double operator()(double value) const { return value; }
+  };
+
+  // the left and right markers -1 and -2 of line strings swap under mirroring
+  struct line_mirror
+  {
+    double operator()(double value) const { return value < 0 ? -3.0 - value : value; }
+  };
+
+  // result[r] is true if the string rotated by r is a palindrome, comparing
+  // each value with the mirrored value at the opposite position. The middle
+  // value of a string with odd size is not compared. The string rotated by r
+  // is a palindrome iff the string matches its mirrored reverse rotated by
+  // -2r, all rotations are matched at once with the Z-function of the string
+  // against the twice repeated mirrored reverse, forwards and backwards.
+  template<typename MirrorT, typename NumericConfigT>
+  std::vector<bool> palindrome_rotations(std::vector<double> const & string, MirrorT mirror, NumericConfigT nc)
+  {
+    std::size_t size = string.size();
+    std::vector<bool> result(size, false);
+    if (size == 0)
+      return result;
+
+    std::vector<double> values(string);
+    for (std::size_t i = 0; i != size; ++i)
+      values.push_back( mirror(string[size-1-i]) );
+    std::vector<int> symbols = string_symbols(values, nc);
+
+    std::vector<int> forward( symbols.begin(), symbols.begin()+size );
+    std::vector<int> mirrored_forward( symbols.begin()+size, symbols.end() );
+    mirrored_forward.insert( mirrored_forward.end(), symbols.begin()+size, symbols.end() );
+
+    std::vector<int> backward( forward.rbegin(), forward.rend() );
+    std::vector<int> mirrored_backward( mirrored_forward.rbegin(), mirrored_forward.rend() );
+
+    std::vector<int> prefix_lengths = prefix_matches(forward, mirrored_forward);
+    std::vector<int> suffix_lengths = prefix_matches(backward, mirrored_backward);
+
+    for (std::size_t rotate = 0; rotate != size; ++rotate)
+    {
+      std::size_t shift = (size - (2*rotate) % size) % size;
+      int prefix_length = prefix_lengths[shift];
+      int suffix_length = suffix_lengths[size-shift];
+
+      if (size % 2 == 0)
+        result[rotate] = (prefix_length >= static_cast<int>(size));
+      else
+      {
+        // index of the middle value of the rotated string in the string
+        int middle = (size/2 + rotate) % size;
+        result[rotate] = (prefix_length >= middle && suffix_length >= static_cast<int>(size)-1-middle);
+      }
     }
 
-    return true;
+    return result;
   }
 
 
@@ -129,10 +229,11 @@ namespace viennamesh
                                         std::vector<double> const & string, NumericConfigT nc)
   {
     std::vector<double> result;
+    std::vector<bool> palindromes = palindrome_rotations(string, identity_mirror(), nc);
 
     for (std::size_t i = 0; i < string.size()/4; ++i)
     {
-      if (is_palindrome(string, 2*i, nc))
+      if (palindromes[2*i])
       {
         double axis_angle;
 
@@ -170,6 +271,7 @@ namespace viennamesh
   std::vector<int> rotational_symmetries(std::vector<double> const & string, NumericConfigT nc)
   {
     std::vector<int> result;
+    std::size_t period = cyclic_period( string_symbols(string, nc) );
 
     for (std::size_t i = 2; i < string.size(); ++i)
     {
@@ -178,7 +280,7 @@ namespace viennamesh
 
       int freq = string.size()/i;
 
-      if (is_equal(string, freq, nc))
+      if (freq % period == 0)
         result.push_back(i);
     }
 
@@ -378,42 +480,16 @@ namespace viennamesh
 
 
 
-  template<typename ContainerT, typename NumericConfigT>
-  bool is_line_palindrome(ContainerT const & container, int rotate, NumericConfigT nc)
-  {
-    for (int i = 0; i != container.size()/2; ++i)
-    {
-      int i0 = i+rotate;
-      int i1 = container.size()-1-i+rotate;
-
-      double v0 = cyclic_access(container, i0);
-      double v1 = cyclic_access(container, i1);
-
-      if (v0*v1 < 0)
-        return false;
-
-      if (v0 < 0 && v1 < 0)
-      {
-        if (v0+v1 < -3.5 || -2.5 < v0+v1)
-          return false;
-      }
-      else
-        if (!viennagrid::detail::is_equal(nc, v0, v1))
-          return false;
-    }
-
-    return true;
-  }
-
   template<typename IteratorT, typename NumericConfigT>
   std::vector<double> mirror_symmetries_lines(IteratorT triples_begin, IteratorT triples_end,
                                               std::vector<double> const & string, NumericConfigT nc)
   {
     std::vector<double> result;
+    std::vector<bool> palindromes = palindrome_rotations(string, line_mirror(), nc);
 
     for (std::size_t i = 2; i < string.size()/2; i+=3)
     {
-      if (is_line_palindrome(string, i, nc))
+      if (palindromes[i])
       {
 //         std::cout << "Found line palindrom " << i << std::endl;
 
@@ -15,11 +15,14 @@
    License:         MIT (X11), see file LICENSE in the base directory
 =============================================================================== */
 
+#include <algorithm>
 #include <string>
 #include <fstream>
 #include <set>
 #include <map>
 #include <vector>
+#include <sstream>
+#include <stdexcept>
 #include <typeinfo>
 #include <cstdlib>
 
@@ -78,19 +81,77 @@ namespace viennamesh
     std::vector<double> values;
   };
 
-  struct element_t
+  // number of array entries read from the file with one hyperslab selection
+  const hsize_t tdr_chunk_size = 1 << 20;
+
+  // maps a TDR element type code to the viennagrid element type and its vertex count
+  inline bool tdr_element_type(int code, viennagrid_element_type & element_tag, int & vertex_count)
   {
-    viennagrid_element_type element_tag;
-    std::vector<int> vertex_indices;
-  };
+    switch (code)
+    {
+      case 1: element_tag = VIENNAGRID_ELEMENT_TYPE_LINE; vertex_count = 2; return true;
+      case 2: element_tag = VIENNAGRID_ELEMENT_TYPE_TRIANGLE; vertex_count = 3; return true;
+      case 3: element_tag = VIENNAGRID_ELEMENT_TYPE_QUADRILATERAL; vertex_count = 4; return true;
+      case 5: element_tag = VIENNAGRID_ELEMENT_TYPE_TETRAHEDRON; vertex_count = 4; return true;
+      default: return false;
+    }
+  }
 
   struct region_t
   {
     int regnr;
     string name,material;
     int nelements,npointidx;
-    std::vector<element_t> elements;
+
+    // element records as stored in the file, a type code followed by the
+    // vertex indices, element i starts at element_data[element_offsets[i]]
+    std::vector<int> element_data;
+    std::vector<std::size_t> element_offsets;
+    std::vector<viennagrid_element_type> element_tags;
+
     std::map<string,dataset_t> dataset;
+
+    std::size_t element_count() const { return element_offsets.size(); }
+
+    int element_vertex_count(std::size_t i) const
+    {
+      std::size_t end = (i+1 < element_offsets.size()) ? element_offsets[i+1] : element_data.size();
+      return end - element_offsets[i] - 1;
+    }
+
+    int * element_vertices(std::size_t i) { return &element_data[element_offsets[i]+1]; }
+    int const * element_vertices(std::size_t i) const { return &element_data[element_offsets[i]+1]; }
+
+    // builds element_offsets and element_tags from element_data, runs
+    // concurrently for several regions and therefore reports malformed
+    // records with a std::runtime_error instead of mythrow
+    void index_elements()
+    {
+      element_offsets.clear();
+      element_tags.clear();
+      // a record has at most five entries
+      element_offsets.reserve(element_data.size() / 5);
+      element_tags.reserve(element_data.size() / 5);
+
+      std::size_t pos = 0;
+      while (pos < element_data.size())
+      {
+        viennagrid_element_type element_tag;
+        int vertex_count;
+        if (!tdr_element_type(element_data[pos], element_tag, vertex_count))
+        {
+          std::ostringstream message;
+          message << "Element type " << element_data[pos] << " in region " << name << " not known";
+          throw std::runtime_error( message.str() );
+        }
+        if (pos + 1 + vertex_count > element_data.size())
+          throw std::runtime_error( "Element data of region " + name + " is truncated" );
+
+        element_offsets.push_back(pos);
+        element_tags.push_back(element_tag);
+        pos += 1 + vertex_count;
+      }
+    }
   };
 
   struct attributeinfo_c
@@ -101,11 +162,11 @@ namespace viennamesh
   };
 
 
-  template<typename VertexT>
   struct region_contacts
   {
     string region_name;
-    std::vector<element_t> elements;
+    region_t const * region;
+    std::vector<std::size_t> elements;
   };
 
   struct tdr_geometry
@@ -117,6 +178,18 @@ namespace viennamesh
     double trans_matrix[9],trans_move[3];
     std::map< int, std::vector<int> > newly_created_vertices;
 
+    // datasets of the state which are read, all if quantity_names is empty,
+    // none if load_quantities is false
+    bool load_quantities;
+    std::set<string> quantity_names;
+
+    tdr_geometry() : load_quantities(true) {}
+
+    bool is_quantity_requested(string const & name) const
+    {
+      return load_quantities && (quantity_names.empty() || quantity_names.find(name) != quantity_names.end());
+    }
+
     void read_transformation(const Group &trans)
     {
       const DataSet &A=trans.openDataSet("A");
@@ -132,7 +205,7 @@ namespace viennamesh
 
     void read_vertex(const DataSet &vert)
     {
-      const DataSpace &dataspace = vert.getSpace();
+      DataSpace dataspace = vert.getSpace();
       hsize_t dims[10];
       dataspace.getSimpleExtentDims( dims, NULL);
       if (nvertices!=dims[0])
@@ -151,27 +224,35 @@ namespace viennamesh
         mtype2.insertMember( "z", HOFFSET(coord2_t, x[2]), PredType::NATIVE_DOUBLE);
 
       /*
-      * Read two fields x and y from s2 dataset. Fields in the file
-      * are found by their names "x_name" and "y_name".
+      * Read the fields x, y and z from the vertex dataset chunk by chunk.
+      * Fields in the file are found by their names.
       */
-      coord2_t * s2 = new coord2_t[dims[0]];
-      vert.read( s2, mtype2 );
+      vertex.reserve( vertex.size() + dim*dims[0] );
+      std::vector<coord2_t> s2( std::min(dims[0], tdr_chunk_size) );
 
-      for (unsigned int i=0; i<dims[0]; i++)
+      for (hsize_t start = 0; start < dims[0]; start += tdr_chunk_size)
       {
-        vertex.push_back(s2[i].x[0]*10000.);
-        if (dim>1)
-        vertex.push_back(s2[i].x[1]*10000.);
-        if (dim>2)
-        vertex.push_back(s2[i].x[2]*10000.);
-      }
+        hsize_t count = std::min(tdr_chunk_size, dims[0]-start);
+        DataSpace memory_space(1, &count);
+        dataspace.selectHyperslab(H5S_SELECT_SET, &count, &start);
+        vert.read( &s2[0], mtype2, memory_space, dataspace );
 
-      delete[] s2;
+        for (unsigned int i=0; i<count; i++)
+        {
+          vertex.push_back(s2[i].x[0]*10000.);
+          if (dim>1)
+          vertex.push_back(s2[i].x[1]*10000.);
+          if (dim>2)
+          vertex.push_back(s2[i].x[2]*10000.);
+        }
+      }
     }
 
+    // appends the raw element records of elem to the region, they are indexed
+    // by region_t::index_elements once all parts of the region are read
     void read_elements(region_t &region, const DataSet &elem)
     {
-      const DataSpace &dataspace = elem.getSpace();
+      DataSpace dataspace = elem.getSpace();
       int rank = dataspace.getSimpleExtentNdims();
       hsize_t dims[10];
       int ndims = dataspace.getSimpleExtentDims( dims, NULL);
@@ -181,42 +262,16 @@ namespace viennamesh
       if (ndims!=1)
         mythrow("ndims of elements in region " << region.name << " is not one");
 
-      int * el = new int[dims[0]];
-      elem.read( el, PredType::NATIVE_INT);
+      std::size_t old_size = region.element_data.size();
+      region.element_data.resize( old_size + dims[0] );
 
-      unsigned int elct=0;
-      while (elct<dims[0])
+      for (hsize_t start = 0; start < dims[0]; start += tdr_chunk_size)
       {
-        element_t element;
-        switch (el[elct++])
-        {
-          case 1:
-            element.element_tag = VIENNAGRID_ELEMENT_TYPE_LINE;
-            for (int i=0; i<2; i++)
-              element.vertex_indices.push_back(el[elct++]);
-            break;
-          case 2:
-            element.element_tag = VIENNAGRID_ELEMENT_TYPE_TRIANGLE;
-            for (int i=0; i<3; i++)
-              element.vertex_indices.push_back(el[elct++]);
-            break;
-          case 3:
-            element.element_tag = VIENNAGRID_ELEMENT_TYPE_QUADRILATERAL;
-            for (int i=0; i<4; i++)
-              element.vertex_indices.push_back(el[elct++]);
-            break;
-          case 5:
-            element.element_tag = VIENNAGRID_ELEMENT_TYPE_TETRAHEDRON;
-            for (int i=0; i<4; i++)
-              element.vertex_indices.push_back(el[elct++]);
-            break;
-          default:mythrow("Element type " << el[elct-1] << " in region " << region.name << " not known");
-        }
-
-        region.elements.push_back(element);
+        hsize_t count = std::min(tdr_chunk_size, dims[0]-start);
+        DataSpace memory_space(1, &count);
+        dataspace.selectHyperslab(H5S_SELECT_SET, &count, &start);
+        elem.read( &region.element_data[old_size+start], PredType::NATIVE_INT, memory_space, dataspace );
       }
-
-      delete[] el;
     }
 
     void read_region(const int regnr, const Group &reg)
@@ -294,17 +349,23 @@ namespace viennamesh
 
     void read_values(dataset_t &dataset,const DataSet &values)
     {
-      const DataSpace &dataspace = values.getSpace();
+      DataSpace dataspace = values.getSpace();
 //       int rank = dataspace.getSimpleExtentNdims();
       hsize_t dims[10];
       int ndims = dataspace.getSimpleExtentDims( dims, NULL);
       if (dataset.nvalues!=dims[0] || ndims!=1)
         mythrow("Dataset " << dataset.name << " should have " << dataset.nvalues << " values, but has " << dims[0] << " with dimension " << ndims);
 
-      double * v = new double[dims[0]];
-      values.read( v, PredType::NATIVE_DOUBLE);
-      dataset.values.insert(dataset.values.end(),&v[0],&v[dims[0]]);
-      delete[] v;
+      std::size_t old_size = dataset.values.size();
+      dataset.values.resize( old_size + dims[0] );
+
+      for (hsize_t start = 0; start < dims[0]; start += tdr_chunk_size)
+      {
+        hsize_t count = std::min(tdr_chunk_size, dims[0]-start);
+        DataSpace memory_space(1, &count);
+        dataspace.selectHyperslab(H5S_SELECT_SET, &count, &start);
+        values.read( &dataset.values[old_size+start], PredType::NATIVE_DOUBLE, memory_space, dataspace );
+      }
     }
 
     void read_dataset(const Group &dataset)
@@ -312,6 +373,8 @@ namespace viennamesh
       string name = read_string(dataset,"name");
       if (name.find("Stress")!=name.npos)
         return;
+      if (!is_quantity_requested(name))
+        return;
 
       string quantity = read_string(dataset,"quantity");
       int regnr = read_int(dataset,"region");
@@ -410,13 +473,43 @@ namespace viennamesh
         read_region(i,reg);
       }
 
+      // HDF5 is not thread safe in its default build, so only the decoding
+      // of the element records of independent regions runs concurrently
+      std::vector<region_t*> regions;
+      for (std::map<string,region_t>::iterator R=region.begin(); R!=region.end(); R++)
+        regions.push_back( &R->second );
+      std::vector<string> failure_messages( regions.size() );
+
+#ifdef VIENNAMESH_WITH_OPENMP
+      #pragma omp parallel for schedule(dynamic)
+#endif
+      for (int i = 0; i < static_cast<int>(regions.size()); ++i)
+      {
+        // an exception must not leave the parallel region
+        try
+        {
+          regions[i]->index_elements();
+        }
+        catch (std::exception const & ex)
+        {
+          failure_messages[i] = ex.what();
+        }
+      }
+
+      for (std::size_t i = 0; i != failure_messages.size(); ++i)
+      {
+        if (!failure_messages[i].empty())
+          throw std::runtime_error( failure_messages[i] );
+      }
+
       const Group &trans=geometry.openGroup("transformation");
       read_transformation(trans);
       const DataSet &vert=geometry.openDataSet("vertex");
       read_vertex(vert);
       // What do the Units???
 
-      read_attribs0(geometry.openGroup("state_0"));
+      if (load_quantities)
+        read_attribs0(geometry.openGroup("state_0"));
     }
 
     void read_collection(const Group &collection)
@@ -471,51 +564,77 @@ namespace viennamesh
       viennagrid_element_type cell_type = VIENNAGRID_ELEMENT_TYPE_VERTEX;
       for (std::map<string,region_t>::iterator S=region.begin(); S!=region.end(); S++)
       {
-        std::vector<element_t> &elements=S->second.elements;
-        for (std::vector<element_t>::iterator E=elements.begin(); E!=elements.end(); E++)
-        {
-          element_t const & e = *E;
-          cell_type = viennagrid_topological_max( cell_type, e.element_tag );
-        }
+        std::vector<viennagrid_element_type> const & element_tags = S->second.element_tags;
+        for (std::size_t j = 0; j < element_tags.size(); ++j)
+          cell_type = viennagrid_topological_max( cell_type, element_tags[j] );
       }
 
 
-      std::map<string, region_contacts<VertexType> > contact_elements;
+      std::map<string, region_contacts> contact_elements;
+      std::vector<VertexType> cell_vertices;
+
+      // created cells and their TDR vertex indices, used for the contact lookup
+      std::vector<VertexType> cells;
+      std::vector<int const *> cell_vertex_indices;
+      std::vector<int> cell_vertex_counts;
 
       for (std::map<string,region_t>::iterator S=region.begin(); S!=region.end(); S++)
       {
-        string region_name = S->second.name;
+        region_t const & r = S->second;
+        string region_name = r.name;
 
-        std::vector<element_t> &elements=S->second.elements;
-        for (std::vector<element_t>::iterator E=elements.begin(); E!=elements.end(); E++)
+        for (std::size_t j = 0; j < r.element_count(); ++j)
         {
-          element_t const & e = *E;
-
-          std::vector<VertexType> cell_vertices(e.vertex_indices.size());
-          for (std::size_t i = 0; i < e.vertex_indices.size(); ++i)
-            cell_vertices[i] = vertices[e.vertex_indices[i]];
-
-          if (e.element_tag == cell_type)
+          if (r.element_tags[j] == cell_type)
           {
-            viennagrid::make_element( mesh.get_or_create_region(region_name),
-                                      viennagrid::element_tag::from_internal(e.element_tag),
-                                      cell_vertices.begin(), cell_vertices.end() );
+            int const * vertex_indices = r.element_vertices(j);
+            cell_vertices.resize( r.element_vertex_count(j) );
+            for (std::size_t i = 0; i < cell_vertices.size(); ++i)
+              cell_vertices[i] = vertices[vertex_indices[i]];
+
+            cells.push_back( viennagrid::make_element( mesh.get_or_create_region(region_name),
+                                                       viennagrid::element_tag::from_internal(cell_type),
+                                                       cell_vertices.begin(), cell_vertices.end() ) );
+            cell_vertex_indices.push_back( vertex_indices );
+            cell_vertex_counts.push_back( cell_vertices.size() );
           }
           else
           {
             contact_elements[region_name].region_name = region_name + "_contact";
-            contact_elements[region_name].elements.push_back(e);
+            contact_elements[region_name].region = &r;
+            contact_elements[region_name].elements.push_back(j);
           }
         }
       }
 
-      if (extrude_contacts)
+      if (extrude_contacts && !contact_elements.empty())
       {
-        for (typename std::map<string, region_contacts<VertexType> >::iterator rc = contact_elements.begin(); rc != contact_elements.end(); ++rc)
+        // vertex to cell adjacency in compressed rows, the cells using vertex v
+        // are vertex_cells[vertex_cell_offsets[v] .. vertex_cell_offsets[v+1])
+        std::vector<std::size_t> vertex_cell_offsets(nvertices+1, 0);
+        for (std::size_t c = 0; c < cells.size(); ++c)
+          for (int k = 0; k < cell_vertex_counts[c]; ++k)
+            ++vertex_cell_offsets[ cell_vertex_indices[c][k]+1 ];
+        for (unsigned int v = 0; v < nvertices; ++v)
+          vertex_cell_offsets[v+1] += vertex_cell_offsets[v];
+
+        std::vector<std::size_t> vertex_cells( vertex_cell_offsets.back() );
+        {
+          std::vector<std::size_t> next( vertex_cell_offsets.begin(), vertex_cell_offsets.end()-1 );
+          for (std::size_t c = 0; c < cells.size(); ++c)
+            for (int k = 0; k < cell_vertex_counts[c]; ++k)
+              vertex_cells[ next[cell_vertex_indices[c][k]]++ ] = c;
+        }
+
+        for (std::map<string, region_contacts>::iterator rc = contact_elements.begin(); rc != contact_elements.end(); ++rc)
         {
+          region_t const & r = *rc->second.region;
           for (std::size_t i = 0; i < rc->second.elements.size(); ++i)
           {
-            element_t const & element = rc->second.elements[i];
+            std::size_t element = rc->second.elements[i];
+            viennagrid_element_type element_tag = r.element_tags[element];
+            int const * vertex_indices = r.element_vertices(element);
+            int vertex_count = r.element_vertex_count(element);
 //             std::vector<VertexType> handles = rc->second.vertex_handles[i];
 
             PointType center;
@@ -523,10 +642,10 @@ namespace viennamesh
             double size = 0;
 
             viennagrid_element_type contact_tag = VIENNAGRID_ELEMENT_TYPE_NO_ELEMENT;
-            if (element.element_tag == VIENNAGRID_ELEMENT_TYPE_LINE)
+            if (element_tag == VIENNAGRID_ELEMENT_TYPE_LINE)
             {
-              PointType p0 = viennagrid::get_point( vertices[element.vertex_indices[0]] );
-              PointType p1 = viennagrid::get_point( vertices[element.vertex_indices[1]] );
+              PointType p0 = viennagrid::get_point( vertices[vertex_indices[0]] );
+              PointType p1 = viennagrid::get_point( vertices[vertex_indices[1]] );
 
               center = (p0+p1)/2;
               normal = normal_vector(p0, p1);
@@ -535,11 +654,11 @@ namespace viennamesh
               size = std::max(size, viennagrid::distance(center, p1));
               contact_tag = VIENNAGRID_ELEMENT_TYPE_TRIANGLE;
             }
-            else if (element.element_tag == VIENNAGRID_ELEMENT_TYPE_TRIANGLE)
+            else if (element_tag == VIENNAGRID_ELEMENT_TYPE_TRIANGLE)
             {
-              PointType p0 = viennagrid::get_point( vertices[element.vertex_indices[0]] );
-              PointType p1 = viennagrid::get_point( vertices[element.vertex_indices[1]] );
-              PointType p2 = viennagrid::get_point( vertices[element.vertex_indices[2]] );
+              PointType p0 = viennagrid::get_point( vertices[vertex_indices[0]] );
+              PointType p1 = viennagrid::get_point( vertices[vertex_indices[1]] );
+              PointType p2 = viennagrid::get_point( vertices[vertex_indices[2]] );
 
               center = (p0+p1+p2)/3;
               normal = normal_vector(p0, p1, p2);
@@ -559,28 +678,53 @@ namespace viennamesh
 
             PointType other_vertex = center + normal;
 
-            typedef typename viennagrid::result_of::cell_range<MeshT>::type CellRangeType;
-            typedef typename viennagrid::result_of::iterator<CellRangeType>::type CellIteratorType;
+            // the cell sharing the contact facet tells on which side of the
+            // contact the device lies, +1 on the side of the normal, -1 opposite
+            int device_side = 0;
+            int v0 = vertex_indices[0];
+            for (std::size_t a = vertex_cell_offsets[v0]; a != vertex_cell_offsets[v0+1] && device_side == 0; ++a)
+            {
+              std::size_t c = vertex_cells[a];
+
+              int shared = 0;
+              double offset = 0;
+              for (int k = 0; k < cell_vertex_counts[c]; ++k)
+              {
+                int cv = cell_vertex_indices[c][k];
+                if (std::find(vertex_indices, vertex_indices+vertex_count, cv) != vertex_indices+vertex_count)
+                  ++shared;
+                else
+                  offset += viennagrid::inner_prod( viennagrid::get_point(vertices[cv]) - center, normal );
+              }
+
+              if (shared == vertex_count && offset != 0)
+                device_side = (offset > 0) ? 1 : -1;
+            }
 
-            CellRangeType cells(mesh);
-            CellIteratorType cit = cells.begin();
-            for (; cit != cells.end(); ++cit)
+            // no cell shares the whole contact, check the cells around its vertices
+            for (int j = 0; j < vertex_count && device_side == 0; ++j)
             {
-              if ( viennagrid::is_inside(*cit, other_vertex) )
-                break;
+              int v = vertex_indices[j];
+              for (std::size_t a = vertex_cell_offsets[v]; a != vertex_cell_offsets[v+1]; ++a)
+              {
+                if ( viennagrid::is_inside(cells[vertex_cells[a]], other_vertex) )
+                {
+                  device_side = 1;
+                  break;
+                }
+              }
             }
 
-            if (cit != cells.end())
+            if (device_side > 0)
               other_vertex = center - normal;
 
-            std::vector<VertexType> cell_vertices;
             std::vector<int> other_vertex_indices;
 
-//             for (auto index : element.vertex_indices)
-            for (std::vector<int>::const_iterator it = element.vertex_indices.begin(); it != element.vertex_indices.end(); ++it)
+            cell_vertices.clear();
+            for (int j = 0; j < vertex_count; ++j)
             {
-              cell_vertices.push_back( vertices[*it] );
-              other_vertex_indices.push_back( vertices[*it].id().internal() );
+              cell_vertices.push_back( vertices[vertex_indices[j]] );
+              other_vertex_indices.push_back( vertices[vertex_indices[j]].id().internal() );
             }
             cell_vertices.push_back( viennagrid::make_vertex(mesh, other_vertex) );
             newly_created_vertices[ cell_vertices.back().id().index() ] = other_vertex_indices;
@@ -600,121 +744,105 @@ namespace viennamesh
     template<typename MeshT>
     std::vector<viennagrid::quantity_field> quantity_fields(MeshT const & mesh) const
     {
-      typedef typename viennagrid::result_of::element<MeshT>::type VertexType;
-//       typedef typename viennagrid::result_of::element<MeshT>::type CellType;
       typedef typename viennagrid::result_of::region<MeshT>::type RegionType;
 
-      std::map<std::string, viennagrid::quantity_field> quantitiy_fields;
+      typedef typename viennagrid::result_of::const_vertex_range<RegionType>::type ConstVertexRangeType;
+      typedef typename viennagrid::result_of::iterator<ConstVertexRangeType>::type ConstVertexIteratorType;
+
+      std::vector<viennagrid::quantity_field> results;
+      std::map<std::string, std::size_t> quantity_index;
 
       for (std::map<string,region_t>::const_iterator R=region.begin(); R!=region.end(); R++)
       {
-        for (std::map<string,dataset_t>::const_iterator D=R->second.dataset.begin(); D!=R->second.dataset.end(); D++)
-        {
-          string quantity_name = D->second.name;
-          viennagrid::quantity_field & quantities = quantitiy_fields[quantity_name];
-          quantities.init(0, 1);
-          quantities.set_name(quantity_name);
-        }
-      }
-
+        if (R->second.dataset.empty())
+          continue;
 
-      std::map< std::string, std::map<VertexType, int> > count;
+        RegionType region = mesh.get_region(R->second.name);
+        ConstVertexRangeType vertices(region);
 
-      for (std::map<string,region_t>::const_iterator R=region.begin(); R!=region.end(); R++)
-      {
         for (std::map<string,dataset_t>::const_iterator D=R->second.dataset.begin(); D!=R->second.dataset.end(); D++)
         {
           if (D->second.nvalues!=D->second.values.size())
             mythrow("Number of values for dataset " << D->second.name << " on region " << R->second.name << " not ok");
 
-          string region_name = R->second.name;
           string quantity_name = D->second.name;
 
-          RegionType region = mesh.get_region(region_name);
-          viennagrid::quantity_field & quantities = quantitiy_fields[quantity_name];
-
-
-          typedef typename viennagrid::result_of::const_vertex_range<RegionType>::type ConstVertexRangeType;
-          typedef typename viennagrid::result_of::iterator<ConstVertexRangeType>::type ConstVertexIteratorType;
-
-          ConstVertexRangeType vertices(region);
-
-          std::map<typename VertexType::id_type, double> tmp;
-
-          int i = 0;
-          for (ConstVertexIteratorType vit = vertices.begin(); vit != vertices.end(); ++vit, ++i)
+          std::map<std::string, std::size_t>::iterator qit = quantity_index.find(quantity_name);
+          if (qit == quantity_index.end())
           {
-            quantities.set(*vit, D->second.values[i]);
+            qit = quantity_index.insert( std::make_pair(quantity_name, results.size()) ).first;
+            results.push_back( viennagrid::quantity_field() );
+            results.back().init(0, 1);
+            results.back().set_name(quantity_name);
           }
+          viennagrid::quantity_field & quantities = results[qit->second];
 
-          for (std::map< int, std::vector<int> >::const_iterator nvit = newly_created_vertices.begin();
-                                                                 nvit != newly_created_vertices.end();
-                                                               ++nvit)
-          {
-//             double val = 0.0;
-//             for (std::size_t i = 0; i != (*nvit).second.size(); ++i)
-//             {
-//               val += quantities.get( (*nvit).second[i] );
-//             }
-//             val /= (*nvit).second.size();
-//
-//             quantities.set( (*nvit).first, val );
-
-            quantities.set( (*nvit).first, 0.0 );
-          }
+          std::vector<double> const & values = D->second.values;
+          std::size_t i = 0;
+          for (ConstVertexIteratorType vit = vertices.begin(); vit != vertices.end() && i != values.size(); ++vit, ++i)
+            quantities.set(*vit, values[i]);
         }
       }
 
-
-      std::vector<viennagrid::quantity_field> results;
-      for (std::map<std::string, viennagrid::quantity_field>::iterator it = quantitiy_fields.begin();
-                                                                       it != quantitiy_fields.end();
-                                                                     ++it)
+      // vertices created by contact extrusion carry no value in the file
+      for (std::size_t q = 0; q != results.size(); ++q)
       {
-        results.push_back( it->second );
+        for (std::map< int, std::vector<int> >::const_iterator nvit = newly_created_vertices.begin();
+                                                               nvit != newly_created_vertices.end();
+                                                             ++nvit)
+          results[q].set( (*nvit).first, 0.0 );
       }
 
-      return results;
+      // same order as the former name-sorted map
+      std::vector<viennagrid::quantity_field> sorted_results;
+      sorted_results.reserve( results.size() );
+      for (std::map<std::string, std::size_t>::const_iterator qit = quantity_index.begin(); qit != quantity_index.end(); ++qit)
+        sorted_results.push_back( results[qit->second] );
+
+      return sorted_results;
     }
 
+    // drops the vertices not used by any element and renumbers the remaining
+    // ones densely, keeping their relative order
     void correct_vertices()
     {
-      std::map<int,int> hakerl;
-      std::vector<double> vertexsave;
-      for (std::map<string,region_t>::iterator R=region.begin(); R!=region.end(); R++)
+      std::vector<int> new_index( nvertices, -1 );
+      for (std::map<string,region_t>::const_iterator R=region.begin(); R!=region.end(); R++)
       {
-        for (unsigned int j=0; j<R->second.elements.size(); j++)
+        for (std::size_t j=0; j<R->second.element_count(); j++)
         {
-          for (unsigned int i=0; i<R->second.elements[j].vertex_indices.size(); i++)
-            hakerl[R->second.elements[j].vertex_indices[i]];
+          int const * vertex_indices = R->second.element_vertices(j);
+          for (int i=0; i<R->second.element_vertex_count(j); i++)
+            new_index[vertex_indices[i]] = 0;
         }
       }
+
       int ct=0;
-      if (hakerl.size()*dim==vertex.size())
-        return;
-      vertexsave=vertex;
-      vertex.clear();
-      for (std::map<int,int>::iterator I=hakerl.begin(); I!=hakerl.end(); I++)
+      for (unsigned int v=0; v<nvertices; v++)
       {
-        vertex.push_back(vertexsave[I->first*dim]);
-        if (dim==2)
-          vertex.push_back(vertexsave[I->first*dim+1]);
-        if (dim==3)
-          vertex.push_back(vertexsave[I->first*dim+2]);
-        I->second=ct++;
+        if (new_index[v] == 0)
+        {
+          // in place, the target position is never behind the source
+          for (int k=0; k<dim; k++)
+            vertex[ct*dim+k] = vertex[v*dim+k];
+          new_index[v] = ct++;
+        }
       }
+
+      if (static_cast<unsigned int>(ct) == nvertices)
+        return;
+
+      vertex.resize(ct*dim);
       for (std::map<string,region_t>::iterator R=region.begin(); R!=region.end(); R++)
       {
-        for (unsigned int j=0; j<R->second.elements.size(); j++)
+        for (std::size_t j=0; j<R->second.element_count(); j++)
         {
-          for (unsigned int i=0; i<R->second.elements[j].vertex_indices.size(); i++)
-          {
-            int idx=hakerl[R->second.elements[j].vertex_indices[i]];
-            R->second.elements[j].vertex_indices[i]=idx;
-          }
+          int * vertex_indices = R->second.element_vertices(j);
+          for (int i=0; i<R->second.element_vertex_count(j); i++)
+            vertex_indices[i]=new_index[vertex_indices[i]];
         }
       }
-      nvertices=vertex.size()/dim;
+      nvertices=ct;
     }
 
   };
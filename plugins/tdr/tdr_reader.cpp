@@ -123,7 +123,7 @@ namespace viennamesh
       full_filename = filename();
 
 
-    shared_ptr<H5File> file( new H5File(full_filename.c_str(), H5F_ACC_RDWR) );
+    shared_ptr<H5File> file( new H5File(full_filename.c_str(), H5F_ACC_RDONLY) );
 
     if (file->getNumObjs()!=1)
     {
@@ -132,6 +132,14 @@ namespace viennamesh
     }
 
     tdr_geometry geometry;
+
+    if ( get_input<bool>("load_quantities").valid() )
+      geometry.load_quantities = get_input<bool>("load_quantities")();
+
+    data_handle<viennamesh_string> quantity_names = get_input<std::string>("quantity_names");
+    if (quantity_names.valid())
+      geometry.quantity_names = split_names( quantity_names() );
+
     geometry.read_collection(file->openGroup("collection"));
 
     geometry.correct_vertices();
@@ -4545,7 +4545,11 @@ void tetgenmesh::initializepools()
     printf("  tetrahedron per block: %d.\n", b->tetrahedraperblock);
   }
 
-  inittables();
+  // The look-up tables are shared by all meshes, a caller running several
+  //   tetrahedralizations concurrently initializes them once beforehand.
+  if (!b->noinittables) {
+    inittables();
+  }
 
   // There are three input point lists available, which are in, addin,
   //   and bgm->in. These point lists may have different number of
@@ -11567,9 +11571,9 @@ void tetgenmesh::incrementaldelaunay(clock_t& tv)
     if (b->verbose) {
       printf("  Permuting vertices.\n");
     }
-    srand(in->numberofpoints);
+    // randomnation() instead of rand(), the random state is per mesh.
     for (i = 0; i < in->numberofpoints; i++) {
-      randindex = rand() % (i + 1); // randomnation(i + 1);
+      randindex = randomnation(i + 1);
       permutarray[i] = permutarray[randindex];
       permutarray[randindex] = (point) points->traverse();
     }
@@ -23465,9 +23469,8 @@ void tetgenmesh::insertconstrainedpoints(point *insertarray, int arylen,
     }
     point swappoint;
     int randindex;
-    srand(arylen);
     for (i = 0; i < arylen; i++) {
-      randindex = rand() % (i + 1);
+      randindex = randomnation(i + 1);
       swappoint = insertarray[i];
       insertarray[i] = insertarray[randindex];
       insertarray[randindex] = swappoint;
@@ -23769,9 +23772,8 @@ void tetgenmesh::collectremovepoints(arraypool *remptlist)
       // Sort the list of points randomly.
       point *parypt_i, swappt;
       int randindex, i;
-      srand(intptlist->objects);
       for (i = 0; i < intptlist->objects; i++) {
-        randindex = rand() % (i + 1); // randomnation(i + 1);
+        randindex = randomnation(i + 1);
         parypt_i = (point *) fastlookup(intptlist, i);
         parypt = (point *) fastlookup(intptlist, randindex);
         // Swap this two points.
@@ -30873,8 +30875,12 @@ void tetrahedralize(tetgenbehavior *b, tetgenio *in, tetgenio *out,
   m.initializepools();
   m.transfernodes();
 
-  exactinit(b->verbose, b->noexact, b->nostaticfilter,
-            m.xmax - m.xmin, m.ymax - m.ymin, m.zmax - m.zmin);
+  // The predicate globals are shared by all meshes, a caller running several
+  //   tetrahedralizations concurrently initializes them once beforehand.
+  if (!b->noexactinit) {
+    exactinit(b->verbose, b->noexact, b->nostaticfilter,
+              m.xmax - m.xmin, m.ymax - m.ymin, m.zmax - m.zmin);
+  }
 
   tv[1] = clock();
 
@@ -604,6 +604,8 @@ public:
   int nomergevertex;                                               // '-M', 0.
   int noexact;                                                     // '-X', 0.
   int nostaticfilter;                                              // '-X', 0.
+  int noexactinit;                                                 // 0.
+  int noinittables;                                                // 0.
   int zeroindex;                                                   // '-z', 0.
   int facesout;                                                    // '-f', 0.
   int edgesout;                                                    // '-e', 0.
@@ -707,6 +709,8 @@ public:
     use_refinement_callback = 0;
     noexact = 0;
     nostaticfilter = 0;
+    noexactinit = 0;
+    noinittables = 0;
     insertaddpoints = 0;
     regionattrib = 0;
     conforming = 0;
@@ -1375,7 +1379,7 @@ public:
   static int sorgpivot [6], sdestpivot[6], sapexpivot[6];
   static int snextpivot[6];
 
-  void inittables();
+  static void inittables();
 
   // Primitives for tetrahedra.
   inline tetrahedron encode(triface& t);
@@ -1,6 +1,7 @@
 #include "viennameshpp/plugin.hpp"
 #include "tetgen_mesh.hpp"
 #include "tetgen_make_mesh.hpp"
+#include "tetgen_make_mesh_parallel.hpp"
 #include "tetgen_convert.hpp"
 
 
@@ -14,6 +15,7 @@ viennamesh_error viennamesh_plugin_init(viennamesh_context context)
   viennamesh::register_conversion<viennamesh::tetgen::mesh, viennagrid_mesh>(context);
 
   viennamesh::register_algorithm<viennamesh::tetgen::make_mesh>(context);
+  viennamesh::register_algorithm<viennamesh::tetgen::make_mesh_parallel>(context);
   viennamesh::register_algorithm<viennamesh::tetgen_convert>(context);
 
   return VIENNAMESH_SUCCESS;
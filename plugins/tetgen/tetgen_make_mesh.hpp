@@ -16,11 +16,18 @@
 =============================================================================== */
 
 #include "viennameshpp/plugin.hpp"
+#include "tetgen_mesh.hpp"
 
 namespace viennamesh
 {
   namespace tetgen
   {
+    void make_mesh_impl(tetgen::mesh const & input,
+                        tetgen::mesh & output,
+                        point_container const & hole_points,
+                        seed_point_container const & seed_points,
+                        tetgenbehavior options);
+
     class make_mesh : public plugin_algorithm
     {
     public:
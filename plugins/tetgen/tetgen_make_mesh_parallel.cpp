@@ -0,0 +1,472 @@
+/* ============================================================================
+   Copyright (c) 2011-2014, Institute for Microelectronics,
+                            Institute for Analysis and Scientific Computing,
+                            TU Wien.
+
+                            -----------------
+                ViennaMesh - The Vienna Meshing Framework
+                            -----------------
+
+                    http://viennamesh.sourceforge.net/
+
+   License:         MIT (X11), see file LICENSE in the base directory
+=============================================================================== */
+
+#include "tetgen_mesh.hpp"
+#include "tetgen_make_mesh.hpp"
+#include "tetgen_make_mesh_parallel.hpp"
+
+#include "viennameshpp/parallel.hpp"
+#include "viennameshpp/union_find.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace viennamesh
+{
+  namespace tetgen
+  {
+    namespace
+    {
+      // a triangle of a tetrahedron, the vertex indices are sorted so that the
+      // two occurrences of an inner face compare equal
+      struct tet_face
+      {
+        int vertices[3];
+        int tet;
+
+        bool operator<(tet_face const & other) const
+        {
+          if (vertices[0] != other.vertices[0])
+            return vertices[0] < other.vertices[0];
+          if (vertices[1] != other.vertices[1])
+            return vertices[1] < other.vertices[1];
+          return vertices[2] < other.vertices[2];
+        }
+
+        bool same_face(tet_face const & other) const
+        {
+          return vertices[0] == other.vertices[0] &&
+                 vertices[1] == other.vertices[1] &&
+                 vertices[2] == other.vertices[2];
+        }
+      };
+
+      tet_face make_tet_face(int v0, int v1, int v2, int tet)
+      {
+        tet_face face;
+        face.vertices[0] = v0;
+        face.vertices[1] = v1;
+        face.vertices[2] = v2;
+        std::sort(face.vertices, face.vertices+3);
+        face.tet = tet;
+        return face;
+      }
+
+
+      // a connected set of coarse tetrahedra with the same region id, bounded
+      // by the triangles in faces (3 coarse vertex indices per triangle)
+      struct region_component
+      {
+        region_component() : region_id(0), seed_tet(-1), tet_count(0) {}
+
+        int region_id;
+        int seed_tet;
+        int tet_count;
+        std::vector<int> faces;
+      };
+
+      struct larger_component
+      {
+        larger_component(std::vector<region_component> const & components_) : components(components_) {}
+
+        bool operator()(int lhs, int rhs) const
+        {
+          if (components[lhs].tet_count != components[rhs].tet_count)
+            return components[lhs].tet_count > components[rhs].tet_count;
+          return lhs < rhs;
+        }
+
+        std::vector<region_component> const & components;
+      };
+
+
+      // the piecewise linear complex of one component: its boundary triangles,
+      // the global hole points and a seed point inside the component which
+      // marks its tetrahedra with attribute 1 (tetrahedra in enclosed cavities
+      // keep attribute 0 and are dropped when merging)
+      void make_component_geometry(region_component const & component,
+                                   tetgen::mesh const & coarse,
+                                   point_container const & hole_points,
+                                   tetgen::mesh & geometry,
+                                   std::vector<int> & local_to_global)
+      {
+        local_to_global = component.faces;
+        std::sort( local_to_global.begin(), local_to_global.end() );
+        local_to_global.erase( std::unique(local_to_global.begin(), local_to_global.end()), local_to_global.end() );
+
+        geometry.firstnumber = 0;
+        geometry.numberofpoints = local_to_global.size();
+        geometry.pointlist = new REAL[ 3 * geometry.numberofpoints ];
+        for (std::size_t i = 0; i != local_to_global.size(); ++i)
+          std::copy( coarse.pointlist + 3*local_to_global[i], coarse.pointlist + 3*local_to_global[i] + 3, geometry.pointlist + 3*i );
+
+        geometry.numberoffacets = component.faces.size() / 3;
+        geometry.facetlist = new tetgenio::facet[ geometry.numberoffacets ];
+        for (int i = 0; i != geometry.numberoffacets; ++i)
+        {
+          tetgenio::facet & facet = geometry.facetlist[i];
+          tetgenio::init( &facet );
+
+          facet.numberofpolygons = 1;
+          facet.polygonlist = new tetgenio::polygon[1];
+          tetgenio::init( facet.polygonlist );
+
+          tetgenio::polygon & polygon = facet.polygonlist[0];
+          polygon.numberofvertices = 3;
+          polygon.vertexlist = new int[3];
+          for (int j = 0; j != 3; ++j)
+            polygon.vertexlist[j] = std::lower_bound( local_to_global.begin(), local_to_global.end(), component.faces[3*i+j] ) - local_to_global.begin();
+        }
+
+        if (!hole_points.empty())
+        {
+          geometry.numberofholes = hole_points.size();
+          geometry.holelist = new REAL[ 3 * geometry.numberofholes ];
+          for (std::size_t i = 0; i != hole_points.size(); ++i)
+          {
+            geometry.holelist[3*i+0] = hole_points[i][0];
+            geometry.holelist[3*i+1] = hole_points[i][1];
+            geometry.holelist[3*i+2] = hole_points[i][2];
+          }
+        }
+
+        geometry.numberofregions = 1;
+        geometry.regionlist = new REAL[5];
+        for (int j = 0; j != 3; ++j)
+        {
+          geometry.regionlist[j] = 0;
+          for (int k = 0; k != 4; ++k)
+            geometry.regionlist[j] += coarse.pointlist[ 3*coarse.tetrahedronlist[4*component.seed_tet+k] + j ] / 4.0;
+        }
+        geometry.regionlist[3] = 1;
+        geometry.regionlist[4] = 0;
+      }
+    }
+
+
+
+    make_mesh_parallel::make_mesh_parallel() {}
+
+    std::string make_mesh_parallel::name() { return "tetgen_make_mesh_parallel"; }
+
+    bool make_mesh_parallel::run(viennamesh::algorithm_handle &)
+    {
+      data_handle<viennamesh_string> option_string = get_input<viennamesh_string>("option_string");
+      data_handle<double> max_radius_edge_ratio = get_input<double>("max_radius_edge_ratio");
+      data_handle<double> min_dihedral_angle = get_input<double>("min_dihedral_angle");
+      data_handle<double> cell_size = get_input<double>("cell_size");
+
+      data_handle<tetgen::mesh> input_mesh = get_required_input<tetgen::mesh>("geometry");
+      point_handle input_hole_points = get_input<point_handle>("hole_points");
+      seed_point_handle input_seed_points = get_input<seed_point_handle>("seed_points");
+
+      mesh_handle output_mesh = make_data<mesh_handle>();
+
+      point_container hole_points;
+      if (input_hole_points.valid())
+      {
+        hole_points = input_hole_points.get_vector();
+        info(5) << "Found hole " << hole_points.size() << " points" << std::endl;
+      }
+
+      seed_point_container seed_points;
+      if (input_seed_points.valid())
+        seed_points = input_seed_points.get_vector();
+
+
+      // coarse tetrahedralization without Steiner points on the boundary, its
+      // region interfaces are the surface meshes locked for all components
+      tetgen::mesh coarse;
+      {
+        tetgenbehavior coarse_options;
+        coarse_options.zeroindex = 1;
+        coarse_options.quiet = 1;
+        coarse_options.plc = 1;
+        coarse_options.nobisect = 1;
+        coarse_options.nojettison = 1;
+
+        coarse_options.vertexperblock = 1000000;
+        coarse_options.tetrahedraperblock = 1000000;
+        coarse_options.shellfaceperblock = 1000000;
+
+        make_mesh_impl( input_mesh(), coarse, hole_points, seed_points, coarse_options );
+      }
+
+      int coarse_tet_count = coarse.numberoftetrahedra;
+      if (coarse_tet_count == 0)
+      {
+        error(1) << "Coarse tetrahedralization of the geometry is empty" << std::endl;
+        return false;
+      }
+
+      bool has_regions = coarse.numberoftetrahedronattributes != 0;
+      std::vector<int> tet_regions(coarse_tet_count, 0);
+      if (has_regions)
+      {
+        for (int i = 0; i < coarse_tet_count; ++i)
+          tet_regions[i] = coarse.tetrahedronattributelist[i*coarse.numberoftetrahedronattributes] + 0.5;
+      }
+
+
+      std::vector<tet_face> faces(4*coarse_tet_count);
+#ifdef VIENNAMESH_WITH_OPENMP
+      #pragma omp parallel for
+#endif
+      for (int i = 0; i < coarse_tet_count; ++i)
+      {
+        int const * tet = coarse.tetrahedronlist + 4*i;
+        faces[4*i+0] = make_tet_face(tet[1], tet[2], tet[3], i);
+        faces[4*i+1] = make_tet_face(tet[0], tet[2], tet[3], i);
+        faces[4*i+2] = make_tet_face(tet[0], tet[1], tet[3], i);
+        faces[4*i+3] = make_tet_face(tet[0], tet[1], tet[2], i);
+      }
+      parallel_sort( faces.begin(), faces.end() );
+
+      // faces on input facets, tetrahedra are never connected across them
+      std::vector<tet_face> subfaces(coarse.numberoftrifaces);
+      for (int i = 0; i < coarse.numberoftrifaces; ++i)
+        subfaces[i] = make_tet_face(coarse.trifacelist[3*i+0], coarse.trifacelist[3*i+1], coarse.trifacelist[3*i+2], -1);
+      std::sort( subfaces.begin(), subfaces.end() );
+
+
+      union_find<int> tet_components;
+      tet_components.resize(coarse_tet_count);
+      for (std::size_t i = 0; i+1 < faces.size(); ++i)
+      {
+        if ( faces[i].same_face(faces[i+1]) &&
+             tet_regions[faces[i].tet] == tet_regions[faces[i+1].tet] &&
+             !std::binary_search(subfaces.begin(), subfaces.end(), faces[i]) )
+          tet_components.unite(faces[i].tet, faces[i+1].tet);
+      }
+
+      std::vector<region_component> components;
+      std::vector<int> tet_component(coarse_tet_count);
+      {
+        std::vector<int> root_component(coarse_tet_count, -1);
+        for (int i = 0; i < coarse_tet_count; ++i)
+        {
+          int root = tet_components.find(i);
+          if (root_component[root] == -1)
+          {
+            root_component[root] = components.size();
+            components.push_back( region_component() );
+            components.back().region_id = tet_regions[i];
+            components.back().seed_tet = i;
+          }
+
+          tet_component[i] = root_component[root];
+          ++components[tet_component[i]].tet_count;
+        }
+      }
+
+      for (std::size_t i = 0, end = 0; i < faces.size(); i = end)
+      {
+        end = i+1;
+        while (end < faces.size() && faces[i].same_face(faces[end]))
+          ++end;
+
+        if ( end-i == 2 && tet_component[faces[i].tet] == tet_component[faces[i+1].tet] )
+        {
+          // a facet inside a component is kept once so that it is preserved
+          if (std::binary_search(subfaces.begin(), subfaces.end(), faces[i]))
+            end = i+1;
+          else
+            continue;
+        }
+
+        for (std::size_t j = i; j != end; ++j)
+        {
+          if (faces[j].vertices[2] >= input_mesh().numberofpoints)
+          {
+            error(1) << "Coarse tetrahedralization inserted a Steiner point on a region interface" << std::endl;
+            return false;
+          }
+
+          std::vector<int> & component_faces = components[tet_component[faces[j].tet]].faces;
+          component_faces.insert( component_faces.end(), faces[j].vertices, faces[j].vertices+3 );
+        }
+      }
+
+      info(1) << "Number of region components: " << components.size() << std::endl;
+
+      // hole points only save the refinement of enclosed cavities, their
+      // tetrahedra are not marked by the component seed point anyway
+      point_container component_hole_points = hole_points;
+      for (int i = 0; i < input_mesh().numberofholes; ++i)
+        component_hole_points.push_back( viennagrid::make_point(input_mesh().holelist[3*i+0], input_mesh().holelist[3*i+1], input_mesh().holelist[3*i+2]) );
+
+
+      tetgenbehavior options;
+      if (option_string.valid())
+      {
+        options.parse_commandline( const_cast<char*>(option_string().c_str()) );
+      }
+      else
+      {
+        options.vertexperblock = 1000000;
+        options.tetrahedraperblock = 1000000;
+        options.shellfaceperblock = 1000000;
+      }
+
+      if (max_radius_edge_ratio.valid())
+      {
+        options.quality = 1;
+        options.minratio = max_radius_edge_ratio();
+        info(1) << "Using global maximum radius edge ratio: " << max_radius_edge_ratio() << std::endl;
+      }
+
+      if (min_dihedral_angle.valid())
+      {
+        options.quality = 1;
+        options.mindihedral = min_dihedral_angle() / M_PI * 180.0;
+        info(1) << "Using global minimum dihedral angle: " << min_dihedral_angle() << std::endl;
+      }
+
+      if (cell_size.valid())
+      {
+        options.fixedvolume = 1;
+        options.maxvolume = cell_size();
+        info(1) << "Using global maximum cell size: " << cell_size() << std::endl;
+      }
+
+      options.plc = 1;
+      options.nobisect = 1;
+      options.regionattrib = 1;
+      options.nojettison = 1;
+      options.zeroindex = 1;
+      options.quiet = 1;
+      options.verbose = 0;
+      // the robust predicates keep their error bounds and static filters and
+      // tetgen its mesh look-up tables in process-wide globals which
+      // tetrahedralize() would rewrite from every worker, initialize them once
+      // here (static filters off, they depend on the bounding box of each
+      // input) and let the workers skip it
+      options.nostaticfilter = 1;
+      options.init();
+      exactinit( 0, options.noexact, options.nostaticfilter, 1.0, 1.0, 1.0 );
+      tetgenmesh::inittables();
+      options.noexactinit = 1;
+      options.noinittables = 1;
+
+
+      std::vector<int> order(components.size());
+      for (std::size_t i = 0; i != order.size(); ++i)
+        order[i] = i;
+      std::sort( order.begin(), order.end(), larger_component(components) );
+
+      std::vector< shared_ptr<tetgen::mesh> > component_meshes(components.size());
+      for (std::size_t i = 0; i != component_meshes.size(); ++i)
+        component_meshes[i].reset( new tetgen::mesh );
+      std::vector< std::vector<int> > local_to_global(components.size());
+      std::vector<char> failed(components.size(), 0);
+
+#ifdef VIENNAMESH_WITH_OPENMP
+      #pragma omp parallel for schedule(dynamic)
+#endif
+      for (int i = 0; i < static_cast<int>(order.size()); ++i)
+      {
+        int index = order[i];
+        try
+        {
+          tetgen::mesh geometry;
+          make_component_geometry( components[index], coarse, component_hole_points, geometry, local_to_global[index] );
+
+          tetgenbehavior local_options = options;
+          tetrahedralize( &local_options, &geometry, component_meshes[index].get() );
+        }
+        catch (...)
+        {
+          failed[index] = 1;
+        }
+      }
+
+      for (std::size_t i = 0; i != components.size(); ++i)
+      {
+        if (failed[i])
+        {
+          error(1) << "Meshing of region " << components[i].region_id << " (component " << i << ") failed" << std::endl;
+          return false;
+        }
+      }
+
+
+      typedef viennagrid::mesh                                    MeshType;
+      typedef viennagrid::result_of::element<MeshType>::type      VertexType;
+      typedef viennagrid::result_of::element<MeshType>::type      CellType;
+
+      MeshType & mesh = output_mesh();
+
+      std::vector<VertexType> surface_vertices(coarse.numberofpoints);
+      std::vector<bool> has_surface_vertex(coarse.numberofpoints, false);
+
+      int cell_count = 0;
+      for (std::size_t c = 0; c != components.size(); ++c)
+      {
+        tetgen::mesh const & component_mesh = *component_meshes[c];
+        std::vector<int> const & component_vertices = local_to_global[c];
+
+        std::vector<VertexType> vertices(component_mesh.numberofpoints);
+        std::vector<bool> has_vertex(component_mesh.numberofpoints, false);
+
+        for (int i = 0; i < component_mesh.numberoftetrahedra; ++i)
+        {
+          if (static_cast<int>(component_mesh.tetrahedronattributelist[i*component_mesh.numberoftetrahedronattributes] + 0.5) != 1)
+            continue;
+
+          int const * tet = component_mesh.tetrahedronlist + 4*i;
+          for (int j = 0; j != 4; ++j)
+          {
+            int local = tet[j];
+            if (has_vertex[local])
+              continue;
+
+            if (local < static_cast<int>(component_vertices.size()))
+            {
+              int global = component_vertices[local];
+              if (!has_surface_vertex[global])
+              {
+                surface_vertices[global] = viennagrid::make_vertex( mesh,
+                  viennagrid::make_point(coarse.pointlist[3*global+0], coarse.pointlist[3*global+1], coarse.pointlist[3*global+2])
+                );
+                has_surface_vertex[global] = true;
+              }
+              vertices[local] = surface_vertices[global];
+            }
+            else
+            {
+              vertices[local] = viennagrid::make_vertex( mesh,
+                viennagrid::make_point(component_mesh.pointlist[3*local+0], component_mesh.pointlist[3*local+1], component_mesh.pointlist[3*local+2])
+              );
+            }
+            has_vertex[local] = true;
+          }
+
+          CellType cell = viennagrid::make_tetrahedron( mesh, vertices[tet[0]], vertices[tet[1]], vertices[tet[2]], vertices[tet[3]] );
+          if (has_regions)
+            viennagrid::add( mesh.get_or_create_region(components[c].region_id), cell );
+          ++cell_count;
+        }
+
+        component_meshes[c].reset();
+      }
+
+      info(1) << "Merged " << cell_count << " tetrahedra of " << components.size() << " region components" << std::endl;
+
+      set_output( "mesh", output_mesh );
+
+      return true;
+    }
+  }
+}
@@ -0,0 +1,43 @@
+#ifndef VIENNAMESH_ALGORITHM_TETGEN_MAKE_MESH_PARALLEL_HPP
+#define VIENNAMESH_ALGORITHM_TETGEN_MAKE_MESH_PARALLEL_HPP
+
+/* ============================================================================
+   Copyright (c) 2011-2014, Institute for Microelectronics,
+                            Institute for Analysis and Scientific Computing,
+                            TU Wien.
+
+                            -----------------
+                ViennaMesh - The Vienna Meshing Framework
+                            -----------------
+
+                    http://viennamesh.sourceforge.net/
+
+   License:         MIT (X11), see file LICENSE in the base directory
+=============================================================================== */
+
+#include "viennameshpp/plugin.hpp"
+
+namespace viennamesh
+{
+  namespace tetgen
+  {
+    // Meshes each region of the geometry in its own tetgen instance. A coarse
+    // boundary preserving (-pY) tetrahedralization of the whole geometry fixes
+    // the surface triangulation of all regions, each connected region component
+    // is then refined in parallel with the same triangles locked (-Y), so the
+    // region meshes are conforming at their interfaces by construction.
+    class make_mesh_parallel : public plugin_algorithm
+    {
+    public:
+      make_mesh_parallel();
+
+      static std::string name();
+      bool run(viennamesh::algorithm_handle &);
+    };
+  }
+
+}
+
+
+
+#endif
@@ -13,10 +13,39 @@
 =============================================================================== */
 
 #include "affine_transform.hpp"
+
+#include <vector>
 #include "viennagrid/algorithm/geometric_transform.hpp"
 
 namespace viennamesh
 {
+  // x = matrix * x + translate on the flat coordinate buffer of a mesh with
+  // a square matrix, the fixed dimension lets the inner loops unroll
+  template<int dimension>
+  void affine_transform_coords(viennagrid_numeric * coords, int vertex_count,
+                               double const * matrix, double const * translate)
+  {
+#ifdef VIENNAMESH_WITH_OPENMP
+    #pragma omp parallel for
+#endif
+    for (int i = 0; i < vertex_count; ++i)
+    {
+      viennagrid_numeric * point = coords + dimension*i;
+
+      viennagrid_numeric result[dimension];
+      for (int r = 0; r != dimension; ++r)
+      {
+        result[r] = translate[r];
+        for (int c = 0; c != dimension; ++c)
+          result[r] += matrix[r*dimension+c] * point[c];
+      }
+
+      for (int r = 0; r != dimension; ++r)
+        point[r] = result[r];
+    }
+  }
+
+
   affine_transform::affine_transform() {}
   std::string affine_transform::name() { return "affine_transform"; }
 
@@ -26,8 +55,6 @@ namespace viennamesh
     point_handle input_matrix = get_required_input<point_handle>("matrix");
     point_handle input_translate = get_required_input<point_handle>("translate");
 
-    mesh_handle output_mesh = make_data<mesh_handle>();
-
     int geometric_dimension = viennagrid::geometric_dimension( input_mesh() );
 
     viennagrid::point translate = input_translate();
@@ -63,10 +90,43 @@ namespace viennamesh
       for (std::size_t j = 0; j != matrix_rows[i].size(); ++j)
         matrix_values.push_back( matrix_rows[i][j] );
 
-    if (output_mesh != input_mesh)
-      viennagrid::copy( input_mesh(), output_mesh() );
+    // the identity leaves all coordinates unchanged, the input is shared
+    bool is_identity = (row_count == geometric_dimension);
+    for (int i = 0; i != row_count; ++i)
+    {
+      for (int j = 0; j != column_count; ++j)
+        is_identity = is_identity && (matrix_values[i*column_count+j] == (i == j ? 1.0 : 0.0));
+    }
+    for (int i = 0; i != geometric_dimension; ++i)
+      is_identity = is_identity && (translate[i] == 0.0);
+
+    if (is_identity)
+    {
+      set_output( "mesh", input_mesh );
+      return true;
+    }
+
+    mesh_handle output_mesh = make_coordinate_output( "mesh", input_mesh );
+
+    viennagrid_numeric * coords;
+    viennagrid_mesh_vertex_coords_pointer( output_mesh().internal(), &coords );
+
+    viennagrid_int vertex_count;
+    viennagrid_mesh_element_count( output_mesh().internal(), 0, &vertex_count );
+
+    std::vector<double> translate_values( geometric_dimension );
+    for (int i = 0; i != geometric_dimension; ++i)
+      translate_values[i] = translate[i];
 
-    viennagrid::affine_transform( output_mesh(), &matrix_values[0], translate );
+    // a non-square matrix changes the geometric dimension of the mesh
+    if (row_count == geometric_dimension && geometric_dimension == 1)
+      affine_transform_coords<1>( coords, vertex_count, &matrix_values[0], &translate_values[0] );
+    else if (row_count == geometric_dimension && geometric_dimension == 2)
+      affine_transform_coords<2>( coords, vertex_count, &matrix_values[0], &translate_values[0] );
+    else if (row_count == geometric_dimension && geometric_dimension == 3)
+      affine_transform_coords<3>( coords, vertex_count, &matrix_values[0], &translate_values[0] );
+    else
+      viennagrid::affine_transform( output_mesh(), &matrix_values[0], translate );
 
     set_output( "mesh", output_mesh );
 
@@ -15,6 +15,7 @@
 #include "center_mesh.hpp"
 
 #include <set>
+#include <vector>
 #include "viennagrid/algorithm/centroid.hpp"
 
 namespace viennamesh
@@ -28,26 +29,44 @@ namespace viennamesh
     mesh_handle input_mesh = get_input<mesh_handle>("mesh");
     if (input_mesh.valid())
     {
-      mesh_handle output_mesh = make_data<mesh_handle>();
-
       typedef viennagrid::mesh                                                MeshType;
       typedef viennagrid::result_of::point<MeshType>::type                    PointType;
 
-      typedef viennagrid::result_of::const_vertex_range<MeshType>::type       ConstVertexRangeType;
-      typedef viennagrid::result_of::iterator<ConstVertexRangeType>::type     ConstVertexRangeIterator;
-
 
-      viennagrid::copy( input_mesh(), output_mesh() );
-      PointType mesh_centroid = viennagrid::centroid( output_mesh() );
+      PointType mesh_centroid = viennagrid::centroid( input_mesh() );
 
       info(1) << "Mesh centroid " << mesh_centroid << std::endl;
 
-      ConstVertexRangeType vertices( output_mesh() );
-      for (ConstVertexRangeIterator vit = vertices.begin(); vit != vertices.end(); ++vit)
-        viennagrid::set_point( *vit, viennagrid::get_point(*vit) - mesh_centroid );
-
-
-      set_output( "mesh", output_mesh );
+      // an already centered mesh is shared with the input
+      if (viennagrid::norm_2(mesh_centroid) == 0.0)
+        set_output( "mesh", input_mesh );
+      else
+      {
+        mesh_handle output_mesh = make_coordinate_output( "mesh", input_mesh );
+
+        int geometric_dimension = viennagrid::geometric_dimension( output_mesh() );
+        std::vector<viennagrid_numeric> center( geometric_dimension );
+        for (int d = 0; d != geometric_dimension; ++d)
+          center[d] = mesh_centroid[d];
+
+        viennagrid_numeric * coords;
+        viennagrid_mesh_vertex_coords_pointer( output_mesh().internal(), &coords );
+
+        viennagrid_int vertex_count;
+        viennagrid_mesh_element_count( output_mesh().internal(), 0, &vertex_count );
+
+#ifdef VIENNAMESH_WITH_OPENMP
+        #pragma omp parallel for
+#endif
+        for (int i = 0; i < vertex_count; ++i)
+        {
+          viennagrid_numeric * point = coords + i*geometric_dimension;
+          for (int d = 0; d != geometric_dimension; ++d)
+            point[d] -= center[d];
+        }
+
+        set_output( "mesh", output_mesh );
+      }
     }
 
 
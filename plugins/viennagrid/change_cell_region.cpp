@@ -15,10 +15,33 @@
 #include "change_cell_region.hpp"
 
 #include <set>
+#include <vector>
 #include "viennagrid/algorithm/centroid.hpp"
 
 namespace viennamesh
 {
+  // region of the mesh with the given id from a table indexed by region id,
+  // the region is created on first use
+  template<typename RegionT>
+  RegionT const & get_output_region(viennagrid::mesh const & mesh, viennagrid_region_id region_id,
+                                    std::vector<RegionT> & regions, std::vector<bool> & region_valid)
+  {
+    if (region_id >= static_cast<viennagrid_region_id>(regions.size()))
+    {
+      regions.resize( region_id+1 );
+      region_valid.resize( region_id+1, false );
+    }
+
+    if (!region_valid[region_id])
+    {
+      regions[region_id] = mesh.get_or_create_region(region_id);
+      region_valid[region_id] = true;
+    }
+
+    return regions[region_id];
+  }
+
+
   change_cell_region::change_cell_region() {}
   std::string change_cell_region::name() { return "change_cell_region"; }
 
@@ -41,39 +64,59 @@ namespace viennamesh
     typedef viennagrid::result_of::element_range<MeshType>::type ElementRangeType;
     typedef viennagrid::result_of::iterator<ElementRangeType>::type ElementRangeIterator;
 
-    std::map<ElementType, RegionType> cell_region_map;
-
     ElementRangeType input_cells( input_mesh(), cell_dim );
+
+    // region id of each cell by cell index, -1 for cells without region
+    std::vector<viennagrid_region_id> cell_region_ids( input_cells.size(), -1 );
+
+    // output regions by region id, created in the same order as the regions
+    // are first referenced
+    std::vector<RegionType> output_regions;
+    std::vector<bool> output_region_valid;
+
     for (ElementRangeIterator cit = input_cells.begin(); cit != input_cells.end(); ++cit)
     {
       RegionRangeType input_regions(*cit);
       if (input_regions.empty())
         continue;
 
-      cell_region_map[*cit] = output_mesh().get_or_create_region( (*input_regions.begin()).id() );
+      viennagrid_region_id region_id = (*input_regions.begin()).id();
+      cell_region_ids[ (*cit).id().index() ] = region_id;
+      get_output_region( output_mesh(), region_id, output_regions, output_region_valid );
     }
 
     for (std::size_t i = 0; i != cells_to_change.size(); ++i)
     {
-      // assume input is in format "cell_index;new_region_id"
       viennagrid_int cell_index = lexical_cast<viennagrid_int>(cells_to_change[i].substr(0, cells_to_change[i].find(";")));
       viennagrid_region_id new_region_id = lexical_cast<viennagrid_region_id>(cells_to_change[i].substr(cells_to_change[i].find(";")+1));
 
+      if (cell_index < 0 || cell_index >= static_cast<viennagrid_int>(cell_region_ids.size()))
+      {
+        error(1) << "Cell index " << cell_index << " is out of range, the mesh has " << cell_region_ids.size() << " cells" << std::endl;
+        return false;
+      }
+
+      if (new_region_id < 0)
+      {
+        error(1) << "Region id " << new_region_id << " for cell " << cell_index << " is negative" << std::endl;
+        return false;
+      }
+
       viennagrid_element_id cell_id = viennagrid_compose_element_id(cell_dim, cell_index);
       std::cout << "Changing cell with ID " << cell_id << " (index = " << cell_index << ", cell_dim = " << (int)cell_dim << ") to region " << new_region_id << std::endl;
 
-      cell_region_map[ ElementType(input_mesh(), cell_id) ] = output_mesh().get_or_create_region(new_region_id);
+      cell_region_ids[cell_index] = new_region_id;
+      get_output_region( output_mesh(), new_region_id, output_regions, output_region_valid );
     }
 
     viennagrid::result_of::element_copy_map<>::type copy_map( output_mesh(), false );
     for (ElementRangeIterator cit = input_cells.begin(); cit != input_cells.end(); ++cit)
     {
       ElementType new_element = copy_map(*cit);
-      std::map<ElementType, RegionType>::iterator it = cell_region_map.find(*cit);
-      if (it != cell_region_map.end())
-      {
-        viennagrid::add((*it).second, new_element);
-      }
+
+      viennagrid_region_id region_id = cell_region_ids[ (*cit).id().index() ];
+      if (region_id != -1)
+        viennagrid::add( output_regions[region_id], new_element );
     }
 
     set_output( "mesh", output_mesh );
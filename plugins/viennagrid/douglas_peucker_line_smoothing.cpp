@@ -13,7 +13,13 @@
 =============================================================================== */
 
 #include "douglas_peucker_line_smoothing.hpp"
-#include "viennagrid/algorithm/angle.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "viennameshpp/simplex_mesh.hpp"
 
 
 namespace viennamesh
@@ -24,133 +30,137 @@ namespace viennamesh
 
 
 
-  template<typename MeshT, typename ElementT>
-  ElementT other_line(MeshT const & mesh, ElementT line, ElementT vertex)
-  {
-    typedef typename viennagrid::result_of::const_coboundary_range<MeshT>::type ConstCoboundaryElementRangeType;
-    ConstCoboundaryElementRangeType lines(mesh, vertex, 1);
-    return lines[0] == line ? lines[1] : lines[0];
-  }
-
-  template<typename MeshT, typename ElementT>
-  ElementT other_vertex(MeshT const &, ElementT vertex, ElementT line)
+  namespace
   {
-    typedef typename viennagrid::result_of::const_element_range<ElementT>::type ConstElementRangeType;
-    ConstElementRangeType vertices(line, 0);
-    return vertices[0] == vertex ? vertices[1] : vertices[0];
-  }
+    // lines of a 2D mesh with the lines of each vertex
+    struct smoothing_lines : simplex_mesh
+    {
+      std::vector<viennagrid_int> vertex_line_offsets;
+      std::vector<viennagrid_int> vertex_lines;
 
+      viennagrid_numeric x(viennagrid_int vertex) const { return coords[vertex*geometric_dimension]; }
+      viennagrid_numeric y(viennagrid_int vertex) const { return coords[vertex*geometric_dimension+1]; }
 
+      viennagrid_int degree(viennagrid_int vertex) const
+      { return vertex_line_offsets[vertex+1] - vertex_line_offsets[vertex]; }
 
-  template<typename MeshT, typename ElementT, typename AccessorT, typename PolylineContainerT>
-  void extract_polyline(MeshT const & mesh,
-                        ElementT vertex, ElementT line,
-                        AccessorT & polyline_ids,
-                        PolylineContainerT & polylines,
-                        viennagrid_numeric min_angle)
-  {
-    polylines.resize(polylines.size()+1);
-    typename PolylineContainerT::value_type & polyline = polylines.back();
+      viennagrid_int other_vertex(viennagrid_int line, viennagrid_int vertex) const
+      { return cell_vertices[2*line] == vertex ? cell_vertices[2*line+1] : cell_vertices[2*line]; }
 
-    while (true)
-    {
-      polyline_ids.set(line, true);
-
-      ElementT next_vertex = other_vertex(mesh, vertex, line);
-      polyline.push_back(next_vertex);
-      if (viennagrid::coboundary_elements(mesh, next_vertex, 1).size() != 2)
-        break;
-
-      ElementT next_line = other_line(mesh, line, next_vertex);
-      if (polyline_ids.get(next_line))
-        break;
-
-      ElementT nv2 = other_vertex(mesh, next_vertex, next_line);
-      viennagrid_numeric angle = viennagrid::angle(viennagrid::get_point(vertex),
-                                                   viennagrid::get_point(nv2),
-                                                   viennagrid::get_point(next_vertex));
-      if (angle < min_angle)
+      // the other line of a vertex with two lines
+      viennagrid_int other_line(viennagrid_int vertex, viennagrid_int line) const
       {
-        std::cout << "Angle = " << angle << " (min_angle=" << min_angle << ")" << std::endl;
-        break;
+        viennagrid_int first = vertex_lines[ vertex_line_offsets[vertex] ];
+        return first == line ? vertex_lines[ vertex_line_offsets[vertex]+1 ] : first;
       }
 
-      line = next_line;
-      vertex = next_vertex;
-    }
-  }
-
-
-
-  viennagrid_numeric distance(viennagrid::point const & p,
-                              viennagrid::point const & l1, viennagrid::point const & l2)
-  {
-    // https://en.wikipedia.org/wiki/Distance_from_a_point_to_a_line#Line_defined_by_two_points
-    viennagrid_numeric x0 = p[0];
-    viennagrid_numeric y0 = p[1];
-    viennagrid_numeric x1 = l1[0];
-    viennagrid_numeric y1 = l1[1];
-    viennagrid_numeric x2 = l2[0];
-    viennagrid_numeric y2 = l2[1];
-
-    return std::abs((y2-y1)*x0 - (x2-x1)*y0 + x2*y1 - y2*x1) / std::sqrt((y2-y1)*(y2-y1) + (x2-x1)*(x2-x1)) ;
-  }
-
-  viennagrid_numeric distance(viennagrid::const_element const & vp,
-                              viennagrid::const_element const & vl1, viennagrid::const_element const & vl2)
-  {
-    if (vl1 == vl2)
-      return viennagrid::norm_2( viennagrid::get_point(vp) - viennagrid::get_point(vl1) );
+      // angle at vertex middle between the vertices first and last
+      viennagrid_numeric angle(viennagrid_int first, viennagrid_int last, viennagrid_int middle) const
+      {
+        double ux = x(first) - x(middle);
+        double uy = y(first) - y(middle);
+        double vx = x(last) - x(middle);
+        double vy = y(last) - y(middle);
+        double c = (ux*vx + uy*vy) / std::sqrt( (ux*ux + uy*uy) * (vx*vx + vy*vy) );
+        return std::acos( std::max(-1.0, std::min(1.0, c)) );
+      }
 
-    return distance( viennagrid::get_point(vp), viennagrid::get_point(vl1), viennagrid::get_point(vl2) );
-  }
+      // distance of vertex p to the line through l1 and l2, or to l1 if both are the same vertex
+      viennagrid_numeric distance(viennagrid_int p, viennagrid_int l1, viennagrid_int l2) const
+      {
+        viennagrid_numeric x0 = x(p);
+        viennagrid_numeric y0 = y(p);
+        viennagrid_numeric x1 = x(l1);
+        viennagrid_numeric y1 = y(l1);
+
+        if (l1 == l2)
+          return std::sqrt( (x0-x1)*(x0-x1) + (y0-y1)*(y0-y1) );
+
+        // https://en.wikipedia.org/wiki/Distance_from_a_point_to_a_line#Line_defined_by_two_points
+        viennagrid_numeric x2 = x(l2);
+        viennagrid_numeric y2 = y(l2);
+        return std::abs((y2-y1)*x0 - (x2-x1)*y0 + x2*y1 - y2*x1) / std::sqrt((y2-y1)*(y2-y1) + (x2-x1)*(x2-x1)) ;
+      }
+    };
 
 
+    // Follows the lines from vertex over line until a vertex without two lines,
+    // an already visited line or an angle below min_angle and appends the
+    // vertices after vertex to polyline_vertices.
+    void extract_polyline(smoothing_lines const & lines,
+                          viennagrid_int vertex, viennagrid_int line,
+                          std::vector<char> & visited,
+                          std::vector<viennagrid_int> & polyline_vertices,
+                          viennagrid_numeric min_angle)
+    {
+      while (true)
+      {
+        visited[line] = true;
 
+        viennagrid_int next_vertex = lines.other_vertex(line, vertex);
+        polyline_vertices.push_back(next_vertex);
+        if (lines.degree(next_vertex) != 2)
+          break;
 
+        viennagrid_int next_line = lines.other_line(next_vertex, line);
+        if (visited[next_line])
+          break;
 
-  template<typename ElementT>
-  std::deque<ElementT> douglas_peucker(std::deque<ElementT> const & vertices,
-                                       viennagrid_numeric eps)
-  {
-    if (vertices.size() == 2)
-      return vertices;
+        viennagrid_int nv2 = lines.other_vertex(next_line, next_vertex);
+        if (lines.angle(vertex, nv2, next_vertex) < min_angle)
+          break;
 
-    viennagrid_numeric max_distance = -1;
-    std::size_t max_index = 0;
-    for (std::size_t i = 1; i != vertices.size()-1; ++i)
-    {
-      viennagrid_numeric d = distance( vertices[i], vertices.front(), vertices.back() );
-      if (d > max_distance)
-      {
-        max_distance = d;
-        max_index = i;
+        line = next_line;
+        vertex = next_vertex;
       }
     }
 
-    std::deque<ElementT> res;
-    if (max_distance > eps)
-    {
-      std::deque<ElementT> res1 = douglas_peucker(std::deque<ElementT>(vertices.begin(), vertices.begin()+max_index+1),
-                                                  eps);
-      std::deque<ElementT> res2 = douglas_peucker(std::deque<ElementT>(vertices.begin()+max_index, vertices.end()),
-                                                  eps);
 
-      std::copy(res1.begin(), res1.end(), std::back_inserter(res));
-      std::copy(res2.begin()+1, res2.end(), std::back_inserter(res));
-    }
-    else
+    // Marks the vertices of polyline [first, last) kept by the Douglas-Peucker
+    // algorithm. The ranges still to be simplified are kept on stack instead of
+    // recursing, the first and last vertex are always kept.
+    void douglas_peucker(smoothing_lines const & lines,
+                         viennagrid_int const * first, viennagrid_int const * last,
+                         char * keep,
+                         std::vector< std::pair<long, long> > & stack,
+                         viennagrid_numeric eps)
     {
-      res.push_back( vertices.front() );
-      res.push_back( vertices.back() );
-    }
+      long count = last - first;
+      keep[0] = true;
+      keep[count-1] = true;
 
-    return res;
+      stack.clear();
+      stack.push_back( std::make_pair(0l, count-1) );
+      while (!stack.empty())
+      {
+        long begin = stack.back().first;
+        long end = stack.back().second;
+        stack.pop_back();
+
+        viennagrid_numeric max_distance = -1;
+        long max_index = begin;
+        for (long i = begin+1; i < end; ++i)
+        {
+          viennagrid_numeric d = lines.distance( first[i], first[begin], first[end] );
+          if (d > max_distance)
+          {
+            max_distance = d;
+            max_index = i;
+          }
+        }
+
+        if (max_distance > eps)
+        {
+          keep[max_index] = true;
+          stack.push_back( std::make_pair(begin, max_index) );
+          stack.push_back( std::make_pair(max_index, end) );
+        }
+      }
+    }
   }
 
 
 
-
   bool douglas_peucker_line_smoothing::run(viennamesh::algorithm_handle &)
   {
     mesh_handle input_mesh = get_required_input<mesh_handle>("mesh");
@@ -159,68 +169,105 @@ namespace viennamesh
 
     mesh_handle output_mesh = make_data<mesh_handle>();
 
-    typedef viennagrid::mesh MeshType;
-    typedef viennagrid::result_of::element<MeshType>::type ElementType;
-    typedef viennagrid::result_of::const_element_range<MeshType>::type ConstElementRangeType;
-    typedef viennagrid::result_of::iterator<ConstElementRangeType>::type ConstElementRangeIterator;
-    typedef viennagrid::result_of::const_coboundary_range<MeshType>::type ConstCoboundaryElementRangeType;
-    typedef viennagrid::result_of::iterator<ConstCoboundaryElementRangeType>::type ConstCoboundaryElementRangeIterator;
+    smoothing_lines lines;
+    read_simplex_mesh(input_mesh(), 1, lines);
+    make_vertex_cells(lines, lines.vertex_line_offsets, lines.vertex_lines);
 
-    int line_count = viennagrid::elements(input_mesh(), 1).size();
-    std::vector<bool> polyline_id_cont(line_count, false);
-    viennagrid::result_of::accessor<std::vector<bool>, ElementType>::type polyline_ids(polyline_id_cont);
+    viennagrid_int vertex_count = lines.vertex_count();
+    viennagrid_int line_count = lines.cell_count();
 
-    std::vector< std::deque<ElementType> > polylines;
+    // polylines in flat arrays, polyline i has the vertices
+    // [polyline_offsets[i], polyline_offsets[i+1]) of polyline_vertices
+    std::vector<char> visited(line_count, false);
+    std::vector<viennagrid_int> polyline_vertices;
+    std::vector<viennagrid_int> polyline_offsets(1, 0);
 
-    ConstElementRangeType vertices(input_mesh(), 0);
-    for (ConstElementRangeIterator vit = vertices.begin(); vit != vertices.end(); ++vit)
+    for (viennagrid_int v = 0; v != vertex_count; ++v)
     {
-      ConstCoboundaryElementRangeType lines(input_mesh(),*vit, 1);
-      if (lines.size() == 2)
+      if (lines.degree(v) == 2)
         continue;
 
-      for (ConstCoboundaryElementRangeIterator lit = lines.begin(); lit != lines.end(); ++lit)
+      for (viennagrid_int i = lines.vertex_line_offsets[v]; i != lines.vertex_line_offsets[v+1]; ++i)
       {
-        if (polyline_ids.get(*lit))
+        viennagrid_int line = lines.vertex_lines[i];
+        if (visited[line])
           continue;
 
-        extract_polyline(input_mesh(), *vit, *lit, polyline_ids, polylines, min_angle());
-        polylines.back().push_front(*vit);
+        polyline_vertices.push_back(v);
+        extract_polyline(lines, v, line, visited, polyline_vertices, min_angle());
+        polyline_offsets.push_back( polyline_vertices.size() );
       }
     }
 
-    ConstElementRangeType lines(input_mesh(), 1);
-    for (ConstElementRangeIterator lit = lines.begin(); lit != lines.end(); ++lit)
+    // the remaining lines form closed loops, which are split in two halves
+    for (viennagrid_int line = 0; line != line_count; ++line)
     {
-      if (polyline_ids.get(*lit))
+      if (visited[line])
         continue;
 
-      extract_polyline(input_mesh(), viennagrid::elements(*lit,0)[0], *lit, polyline_ids, polylines, min_angle());
-      polylines.back().push_front(viennagrid::elements(*lit,0)[0]);
+      viennagrid_int v = lines.cell_vertices[2*line];
+      std::size_t first = polyline_vertices.size();
+      polyline_vertices.push_back(v);
+      extract_polyline(lines, v, line, visited, polyline_vertices, min_angle());
 
-      std::deque<ElementType> & pl = polylines.back();
-      int hs = polylines.back().size()/2;
-      polylines.resize(polylines.size()+1);
-      std::copy(pl.begin()+hs, pl.end(), std::back_inserter(polylines.back()));
-      pl.erase(pl.begin()+hs+1, pl.end());
+      std::size_t half = first + (polyline_vertices.size()-first)/2;
+      polyline_offsets.push_back( half+1 );
+      polyline_vertices.insert( polyline_vertices.begin()+half+1, polyline_vertices[half] );
+      polyline_offsets.push_back( polyline_vertices.size() );
     }
 
 
+    // the polylines are independent and simplified concurrently
+    long polyline_count = polyline_offsets.size()-1;
+    std::vector<char> keep( polyline_vertices.size(), false );
 
-    viennagrid::result_of::element_copy_map<>::type copy_map( output_mesh(), false );
-    for (std::size_t i = 0; i != polylines.size(); ++i)
+#ifdef VIENNAMESH_WITH_OPENMP
+    #pragma omp parallel
+#endif
     {
-      std::deque<ElementType> polyline = douglas_peucker(polylines[i], eps());
+      std::vector< std::pair<long, long> > stack;
 
-      ElementType ov = copy_map( polyline[0] );
-      for (std::size_t j = 1; j != polyline.size(); ++j)
+#ifdef VIENNAMESH_WITH_OPENMP
+      #pragma omp for schedule(dynamic, 64)
+#endif
+      for (long i = 0; i < polyline_count; ++i)
       {
-        ElementType v = copy_map( polyline[j] );
-        viennagrid::make_line(output_mesh(), ov, v);
-        ov = v;
+        douglas_peucker( lines,
+                         &polyline_vertices[0] + polyline_offsets[i],
+                         &polyline_vertices[0] + polyline_offsets[i+1],
+                         &keep[0] + polyline_offsets[i],
+                         stack, eps() );
       }
     }
 
+
+    // the kept vertices of each polyline are joined by lines, vertices are
+    // created in the order of their first use
+    simplex_mesh output_lines;
+    output_lines.geometric_dimension = lines.geometric_dimension;
+    output_lines.vertices_per_cell = 2;
+    output_lines.coords.swap(lines.coords);
+
+    for (long i = 0; i != polyline_count; ++i)
+    {
+      viennagrid_int previous = -1;
+      for (viennagrid_int j = polyline_offsets[i]; j != polyline_offsets[i+1]; ++j)
+      {
+        if (!keep[j])
+          continue;
+
+        if (previous != -1)
+        {
+          output_lines.cell_vertices.push_back(previous);
+          output_lines.cell_vertices.push_back(polyline_vertices[j]);
+        }
+        previous = polyline_vertices[j];
+      }
+    }
+
+    compact_vertices(output_lines);
+    make_simplex_mesh(output_lines, output_mesh());
+
     set_output("mesh", output_mesh);
 
 
@@ -14,14 +14,219 @@
 
 #include "extract_boundary.hpp"
 
+#include <algorithm>
+#include <iterator>
+#include <vector>
+#include <boost/unordered_map.hpp>
+
 #include "viennagrid/algorithm/extract_hole_points.hpp"
 #include "viennagrid/algorithm/extract_boundary.hpp"
 #include "viennagrid/algorithm/extract_seed_points.hpp"
 
+#include "viennameshpp/parallel.hpp"
+#include "viennameshpp/simplex_mesh.hpp"
 
 
 namespace viennamesh
 {
+  namespace
+  {
+    // sorted vertex indices of a triangle or line facet, unused entries are -1
+    struct facet_key
+    {
+      viennagrid_int v[3];
+
+      bool operator==(facet_key const & other) const
+      { return v[0] == other.v[0] && v[1] == other.v[1] && v[2] == other.v[2]; }
+    };
+
+    struct facet_key_hash
+    {
+      std::size_t operator()(facet_key const & k) const
+      {
+        std::size_t seed = 0;
+        boost::hash_combine(seed, k.v[0]);
+        boost::hash_combine(seed, k.v[1]);
+        boost::hash_combine(seed, k.v[2]);
+        return seed;
+      }
+    };
+
+    // a facet by the cell it was first seen in and the cell vertex it omits,
+    // neighbour is the other cell of an interface facet and -1 otherwise
+    struct facet_use
+    {
+      viennagrid_int cell;
+      int omitted_vertex;
+      viennagrid_int neighbour;
+
+      bool operator<(facet_use const & other) const
+      { return cell < other.cell || (cell == other.cell && omitted_vertex < other.omitted_vertex); }
+    };
+
+
+    facet_key make_facet_key(simplex_mesh const & cells, viennagrid_int cell, int omitted_vertex)
+    {
+      facet_key k;
+      k.v[2] = -1;
+
+      int j = 0;
+      for (int i = 0; i != cells.vertices_per_cell; ++i)
+      {
+        if (i != omitted_vertex)
+          k.v[j++] = cells.cell_vertices[cell*cells.vertices_per_cell + i];
+      }
+      std::sort(k.v, k.v + cells.vertices_per_cell-1);
+      return k;
+    }
+
+    // Finds the facets used by exactly one cell, or by two cells of different
+    // regions. The key of every facet is computed once and the facets are
+    // bucketed into shards by the key hash, each shard is classified by one
+    // thread. A facet is erased from its shard when its second cell is seen,
+    // so the tables only hold the facets not closed yet and finally the boundary.
+    void classify_facets(simplex_mesh const & cells, std::vector<facet_use> & boundary)
+    {
+      typedef boost::unordered_map<facet_key, viennagrid_int, facet_key_hash> FacetMapType;
+
+      int shard_count = thread_count();
+      int vertices_per_cell = cells.vertices_per_cell;
+      viennagrid_int facet_count = cells.cell_count() * vertices_per_cell;
+
+      // facet f omits vertex f % vertices_per_cell of cell f / vertices_per_cell
+      std::vector<facet_key> keys(facet_count);
+      std::vector<int> facet_shards(facet_count);
+      facet_key_hash hash;
+#ifdef VIENNAMESH_WITH_OPENMP
+      #pragma omp parallel for
+#endif
+      for (viennagrid_int f = 0; f < facet_count; ++f)
+      {
+        keys[f] = make_facet_key(cells, f / vertices_per_cell, f % vertices_per_cell);
+        facet_shards[f] = hash(keys[f]) % shard_count;
+      }
+
+      // facets of each shard by counting sort, in increasing order
+      std::vector<viennagrid_int> shard_offsets(shard_count+1, 0);
+      for (viennagrid_int f = 0; f != facet_count; ++f)
+        ++shard_offsets[ facet_shards[f]+1 ];
+      for (int shard = 0; shard != shard_count; ++shard)
+        shard_offsets[shard+1] += shard_offsets[shard];
+
+      std::vector<viennagrid_int> shard_facets(facet_count);
+      std::vector<viennagrid_int> fill( shard_offsets.begin(), shard_offsets.end()-1 );
+      for (viennagrid_int f = 0; f != facet_count; ++f)
+        shard_facets[ fill[facet_shards[f]]++ ] = f;
+      std::vector<int>().swap(facet_shards);
+
+      std::vector< std::vector<facet_use> > shard_boundary(shard_count);
+#ifdef VIENNAMESH_WITH_OPENMP
+      #pragma omp parallel for schedule(static, 1)
+#endif
+      for (int shard = 0; shard < shard_count; ++shard)
+      {
+        FacetMapType open_facets;
+        std::vector<facet_use> & result = shard_boundary[shard];
+
+        for (viennagrid_int i = shard_offsets[shard]; i != shard_offsets[shard+1]; ++i)
+        {
+          viennagrid_int f = shard_facets[i];
+          std::pair<FacetMapType::iterator, bool> inserted = open_facets.insert( std::make_pair(keys[f], f) );
+          if (inserted.second)
+            continue;
+
+          viennagrid_int first = inserted.first->second;
+          open_facets.erase( inserted.first );
+
+          viennagrid_int first_cell = first / vertices_per_cell;
+          viennagrid_int cell = f / vertices_per_cell;
+          if (!cells.same_regions(first_cell, cell))
+          {
+            facet_use use;
+            use.cell = first_cell;
+            use.omitted_vertex = first % vertices_per_cell;
+            use.neighbour = cell;
+            result.push_back(use);
+          }
+        }
+
+        for (FacetMapType::const_iterator fit = open_facets.begin(); fit != open_facets.end(); ++fit)
+        {
+          facet_use use;
+          use.cell = fit->second / vertices_per_cell;
+          use.omitted_vertex = fit->second % vertices_per_cell;
+          use.neighbour = -1;
+          result.push_back(use);
+        }
+      }
+
+      boundary.clear();
+      for (int shard = 0; shard != shard_count; ++shard)
+        boundary.insert( boundary.end(), shard_boundary[shard].begin(), shard_boundary[shard].end() );
+
+      // the same output order for every thread count
+      std::sort( boundary.begin(), boundary.end() );
+    }
+
+
+    // Extracts the facets of a triangle or tetrahedron mesh which are on the
+    // mesh boundary or on the interface of two regions into hull_mesh. Each
+    // facet is added to the regions of its cells, an interface facet to the
+    // regions of both. Returns false if volume_mesh has other cells and
+    // nothing was done.
+    bool extract_simplex_boundary(viennagrid::mesh const & volume_mesh, viennagrid::mesh const & hull_mesh)
+    {
+      simplex_mesh cells;
+      if ( !read_simplex_mesh(volume_mesh, viennagrid::cell_dimension(volume_mesh), cells) ||
+           cells.vertices_per_cell == 2 )
+        return false;
+
+      std::vector<facet_use> boundary;
+      classify_facets(cells, boundary);
+
+      // only the vertices of boundary facets are copied, numbered in the order
+      // of their first use
+      simplex_mesh facets;
+      facets.geometric_dimension = cells.geometric_dimension;
+      facets.vertices_per_cell = cells.vertices_per_cell-1;
+      facets.coords.swap(cells.coords);
+      facets.cell_vertices.reserve( boundary.size() * facets.vertices_per_cell );
+      facets.cell_region_offsets.reserve( boundary.size()+1 );
+      facets.cell_region_offsets.push_back(0);
+
+      for (std::size_t i = 0; i != boundary.size(); ++i)
+      {
+        viennagrid_int cell = boundary[i].cell;
+        for (int j = 0; j != cells.vertices_per_cell; ++j)
+        {
+          if (j != boundary[i].omitted_vertex)
+            facets.cell_vertices.push_back( cells.cell_vertices[cell*cells.vertices_per_cell + j] );
+        }
+
+        std::vector<viennagrid_region_id>::const_iterator regions = cells.cell_regions.begin();
+        viennagrid_int neighbour = boundary[i].neighbour;
+        if (neighbour == -1)
+          facets.cell_regions.insert( facets.cell_regions.end(),
+                                      regions + cells.cell_region_offsets[cell],
+                                      regions + cells.cell_region_offsets[cell+1] );
+        else
+          std::set_union( regions + cells.cell_region_offsets[cell],
+                          regions + cells.cell_region_offsets[cell+1],
+                          regions + cells.cell_region_offsets[neighbour],
+                          regions + cells.cell_region_offsets[neighbour+1],
+                          std::back_inserter(facets.cell_regions) );
+        facets.cell_region_offsets.push_back( facets.cell_regions.size() );
+      }
+
+      compact_vertices(facets);
+      copy_regions(volume_mesh, hull_mesh);
+      make_simplex_mesh(facets, hull_mesh);
+
+      return true;
+    }
+  }
+
+
 
   extract_boundary::extract_boundary() {}
   std::string extract_boundary::name() { return "extract_boundary"; }
@@ -34,9 +239,15 @@ namespace viennamesh
     point_container hole_points;
     seed_point_container seed_points;
 
-    input_mesh().set_full_layout();
-    viennagrid::extract_boundary( input_mesh(), output_mesh(), viennagrid::facet_dimension(input_mesh()) );
+    // triangle and tetrahedron meshes are handled without the full layout,
+    // which would create all intermediate elements of the input mesh
+    if ( !extract_simplex_boundary(input_mesh(), output_mesh()) )
+    {
+      input_mesh().set_full_layout();
+      viennagrid::extract_boundary( input_mesh(), output_mesh(), viennagrid::facet_dimension(input_mesh()) );
+    }
     viennagrid::extract_seed_points( input_mesh(), seed_points );
+
 //     viennagrid::extract_hole_points( input_mesh(), hole_points );
 
     set_output( "mesh", output_mesh );
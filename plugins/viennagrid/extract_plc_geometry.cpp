@@ -18,6 +18,7 @@
 #include "viennagrid/algorithm/extract_hole_points.hpp"
 #include "viennagrid/algorithm/plane_to_2d_projector.hpp"
 #include "viennagrid/algorithm/geometry.hpp"
+#include "viennameshpp/union_find.hpp"
 
 namespace viennamesh
 {
@@ -81,38 +82,56 @@ namespace viennamesh
 
 
 
-  template<typename MeshT, typename CellT, typename SamePLCCellFunctorT,
-           typename VisitedAccessorT, typename PLCIDAccessorT>
-  void recursively_add_neighbours( MeshT const & mesh,
-                                   CellT const & cell,
-                                   SamePLCCellFunctorT same_cell_functor,
-                                   VisitedAccessorT & visited_accessor,
-                                   PLCIDAccessorT & plc_id_accessor,
-                                   int plc_id)
+  // Labels the cells by PLC, two cells sharing a line are in the same PLC if
+  // same_cell_functor holds for them. The PLCs are numbered in the order of
+  // their first cell in the cell range, the number of PLCs is returned.
+  template<typename MeshT, typename SamePLCCellFunctorT, typename PLCIDAccessorT>
+  int set_plc_ids( MeshT const & mesh,
+                   SamePLCCellFunctorT same_cell_functor,
+                   PLCIDAccessorT & plc_id_accessor )
   {
-    typedef typename viennagrid::result_of::point<MeshT>::type PointType;
+    typedef typename viennagrid::result_of::const_cell_range<MeshT>::type ConstCellRangeType;
+    typedef typename viennagrid::result_of::iterator<ConstCellRangeType>::type ConstCellIteratorType;
 
-    if ( visited_accessor.get(cell) )
-      return;
+    typedef typename viennagrid::result_of::const_element_range<MeshT, 1>::type ConstLineRangeType;
+    typedef typename viennagrid::result_of::iterator<ConstLineRangeType>::type ConstLineIteratorType;
 
-    visited_accessor.set(cell, true);
-    plc_id_accessor.set(cell, plc_id);
+    typedef typename viennagrid::result_of::const_coboundary_range<MeshT>::type ConstCoboundaryRangeType;
+    typedef typename viennagrid::result_of::iterator<ConstCoboundaryRangeType>::type ConstCoboundaryIteratorType;
 
-    PointType normal_vector = viennagrid::normal_vector( cell );
-    normal_vector /= viennagrid::norm_2(normal_vector);
+    ConstCellRangeType cells(mesh);
+    union_find<viennagrid_int> plcs( cells.size() );
+
+    ConstLineRangeType lines(mesh);
+    for (ConstLineIteratorType lit = lines.begin(); lit != lines.end(); ++lit)
+    {
+      ConstCoboundaryRangeType line_cells(mesh, *lit, viennagrid::topologic_dimension(mesh));
+      for (ConstCoboundaryIteratorType it = line_cells.begin(); it != line_cells.end(); ++it)
+      {
+        ConstCoboundaryIteratorType jt = it;
+        for (++jt; jt != line_cells.end(); ++jt)
+        {
+          viennagrid_int lhs = (*it).id().index();
+          viennagrid_int rhs = (*jt).id().index();
 
-    typedef typename viennagrid::result_of::const_neighbor_range<MeshT>::type NeighbourRangeType;
-    typedef typename viennagrid::result_of::iterator<NeighbourRangeType>::type NeighbourRangeIterator;
+          if ( !plcs.same(lhs, rhs) && same_cell_functor(*it, *jt) )
+            plcs.unite(lhs, rhs);
+        }
+      }
+    }
 
-    NeighbourRangeType neighbors(mesh, cell, 1, viennagrid::topologic_dimension(mesh));
-    for (NeighbourRangeIterator it = neighbors.begin(); it != neighbors.end(); ++it)
+    std::vector<int> plc_ids( cells.size(), -1 );
+    int plc_count = 0;
+    for (ConstCellIteratorType cit = cells.begin(); cit != cells.end(); ++cit)
     {
-      if ( visited_accessor.get(*it) )
-        continue;
+      int & plc_id = plc_ids[ plcs.find((*cit).id().index()) ];
+      if (plc_id == -1)
+        plc_id = plc_count++;
 
-      if ( same_cell_functor(cell, *it) )
-        recursively_add_neighbours( mesh, *it, same_cell_functor, visited_accessor, plc_id_accessor, plc_id );
+      plc_id_accessor.set(*cit, plc_id);
     }
+
+    return plc_count;
   }
 
 
@@ -138,20 +157,9 @@ namespace viennamesh
 
     ConstCellRangeType cells(mesh);
 
-    std::vector<bool> cell_visited_container( cells.size(), false );
-    typename viennagrid::result_of::accessor< std::vector<bool>, ElementType >::type cell_visited(cell_visited_container);
-
     std::vector<int> plc_id_container( cells.size(), -1 );
     typename viennagrid::result_of::accessor< std::vector<int>, ElementType >::type plc_ids(plc_id_container);
-    int lowest_plc_id = 0;
-
-    for (ConstCellIteratorType cit = cells.begin(); cit != cells.end(); ++cit)
-    {
-      if ( cell_visited.get(*cit) )
-        continue;
-
-      recursively_add_neighbours( mesh, *cit, same_plc_functor, cell_visited, plc_ids, lowest_plc_id++ );
-    }
+    int lowest_plc_id = set_plc_ids( mesh, same_plc_functor, plc_ids );
 
     std::map<ElementType, viennagrid_int> vertex_map;
 
@@ -14,6 +14,7 @@
 
 #include "hull_set_regions.hpp"
 #include "viennagrid/algorithm/distance.hpp"
+#include "viennameshpp/union_find.hpp"
 #include <memory>
 #include <set>
 #include <iterator>
@@ -22,46 +23,52 @@ namespace viennamesh
 {
 
 
-  template<typename MeshT, typename ElementT, typename AccessorT, typename ToSetT>
-  void set_neighbors(MeshT const & mesh,
-                     ElementT const & element,
-                     AccessorT & accessor,
-                     ToSetT to_set,
-                     ToSetT invalid,
-                     viennagrid_int connector_topologic_dimension)
+  // Labels the triangles of a hull by edge connected patches, two triangles are
+  // connected if they share a line which has exactly two coboundary triangles.
+  // The patches are numbered in the order of their first triangle in the cell
+  // range, the number of patches is returned.
+  template<typename MeshT, typename AccessorT>
+  int set_patch_regions(MeshT const & mesh, AccessorT & accessor)
   {
-    if (accessor.get(element) != invalid)
-      return;
+    typedef typename viennagrid::result_of::const_cell_range<MeshT>::type ConstCellRangeType;
+    typedef typename viennagrid::result_of::iterator<ConstCellRangeType>::type ConstCellRangeIterator;
 
-    accessor.set(element, to_set);
+    typedef typename viennagrid::result_of::const_element_range<MeshT, 1>::type ConstLineRangeType;
+    typedef typename viennagrid::result_of::iterator<ConstLineRangeType>::type ConstLineRangeIterator;
 
-    typedef typename viennagrid::result_of::const_element_range<ElementT, 1>::type ConstBoundaryLineRangeType;
-    typedef typename viennagrid::result_of::iterator<ConstBoundaryLineRangeType>::type ConstBoundaryLineRangeIterator;
+    typedef typename viennagrid::result_of::const_coboundary_range<MeshT>::type ConstCoboundaryTriangleRangeType;
+    typedef typename viennagrid::result_of::iterator<ConstCoboundaryTriangleRangeType>::type ConstCoboundaryTriangleRangeIterator;
 
-    ConstBoundaryLineRangeType boundary_lines(element);
-    for (ConstBoundaryLineRangeIterator blit = boundary_lines.begin(); blit != boundary_lines.end(); ++blit)
-    {
-      typedef typename viennagrid::result_of::const_coboundary_range<MeshT, 2>::type ConstCoboundaryTriangleRangeType;
-      typedef typename viennagrid::result_of::iterator<ConstCoboundaryTriangleRangeType>::type ConstCoboundaryTriangleRangeIterator;
-
-      ConstCoboundaryTriangleRangeType neigbor_triangles(mesh, *blit);
+    ConstCellRangeType cells(mesh);
+    union_find<viennagrid_int> patches( cells.size() );
 
-//       if (neigbor_triangles.size() == 1)
-//         std::cout << "ERROR!!!" << std::endl;
+    ConstLineRangeType lines(mesh);
+    for (ConstLineRangeIterator lit = lines.begin(); lit != lines.end(); ++lit)
+    {
+      ConstCoboundaryTriangleRangeType neigbor_triangles(mesh, *lit, 2);
 
       // skip lines which have not exactly 2 coboundary triangles
       if (neigbor_triangles.size() != 2)
         continue;
 
-      for (ConstCoboundaryTriangleRangeIterator ntit = neigbor_triangles.begin(); ntit != neigbor_triangles.end(); ++ntit)
-      {
-        // skip this
-        if (*ntit == element)
-          continue;
+      ConstCoboundaryTriangleRangeIterator ntit = neigbor_triangles.begin();
+      viennagrid_int first = (*ntit).id().index();
+      ++ntit;
+      patches.unite( first, (*ntit).id().index() );
+    }
 
-        set_neighbors(mesh, *ntit, accessor, to_set, invalid, connector_topologic_dimension);
-      }
+    std::vector<int> patch_ids( cells.size(), -1 );
+    int patch_count = 0;
+    for (ConstCellRangeIterator cit = cells.begin(); cit != cells.end(); ++cit)
+    {
+      int & patch_id = patch_ids[ patches.find((*cit).id().index()) ];
+      if (patch_id == -1)
+        patch_id = patch_count++;
+
+      accessor.set(*cit, patch_id);
     }
+
+    return patch_count;
   }
 
 
@@ -112,12 +119,7 @@ namespace viennamesh
     typedef viennagrid::result_of::accessor< std::vector<int>, ElementType >::type RegionAccessorType;
     RegionAccessorType cell_region( cell_region_container );
 
-    int region_count = 0;
-    for (ConstCellRangeIterator cit = cells.begin(); cit != cells.end(); ++cit)
-    {
-      if (cell_region.get(*cit) == -1)
-        set_neighbors( input_mesh(), *cit, cell_region, region_count++, -1, 2 );
-    }
+    int region_count = set_patch_regions( input_mesh(), cell_region );
 
     info(1) << "Number of regions: " << region_count << std::endl;
 
@@ -13,10 +13,352 @@
 =============================================================================== */
 
 #include "hyperplane_clip.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 #include "viennagrid/algorithm/refine.hpp"
 
+#include "viennameshpp/parallel.hpp"
+#include "viennameshpp/simplex_mesh.hpp"
+
 namespace viennamesh
 {
+  namespace
+  {
+    // vertex permutations of a prism which keep its triangles and quads,
+    // permutation i moves vertex i to position 0
+    int const prism_permutations[6][6] = { {0,1,2,3,4,5}, {1,2,0,4,5,3}, {2,0,1,5,3,4},
+                                           {3,5,4,0,2,1}, {4,3,5,1,0,2}, {5,4,3,2,1,0} };
+
+    // side of a vertex relative to the hyperplane
+    enum { inside = -1, on_plane = 0, outside = 1 };
+
+
+    // Collects the cells of the part of a cell inside the hyperplane. Quads
+    // shared with neighbours are always split along the diagonal through their
+    // smallest vertex index, so the clipped mesh stays conforming.
+    class clip_cell_builder
+    {
+    public:
+
+      clip_cell_builder(std::vector<viennagrid_int> & cells_) : cells(cells_) {}
+
+      void triangle(viennagrid_int a, viennagrid_int b, viennagrid_int c)
+      {
+        cells.push_back(a); cells.push_back(b); cells.push_back(c);
+      }
+
+      void tetrahedron(viennagrid_int a, viennagrid_int b, viennagrid_int c, viennagrid_int d)
+      {
+        cells.push_back(a); cells.push_back(b); cells.push_back(c); cells.push_back(d);
+      }
+
+      // convex polygon with vertices in cyclic order, fanned from its smallest vertex
+      void polygon(viennagrid_int const * vertices, int count)
+      {
+        int first = std::min_element(vertices, vertices+count) - vertices;
+        for (int i = 1; i+1 < count; ++i)
+          triangle( vertices[first], vertices[(first+i)%count], vertices[(first+i+1)%count] );
+      }
+
+      // pyramid with the quad q0 q1 q2 q3 in cyclic order and the apex
+      void pyramid(viennagrid_int q0, viennagrid_int q1, viennagrid_int q2, viennagrid_int q3, viennagrid_int apex)
+      {
+        if ( std::min(q0, q2) < std::min(q1, q3) )
+        {
+          tetrahedron(q0, q1, q2, apex);
+          tetrahedron(q0, q2, q3, apex);
+        }
+        else
+        {
+          tetrahedron(q1, q2, q3, apex);
+          tetrahedron(q1, q3, q0, apex);
+        }
+      }
+
+      // prism with triangles v0 v1 v2 and v3 v4 v5, vi and vi+3 connected,
+      // split into three tetrahedra after Dompierre et al.
+      void prism(viennagrid_int const * prism_vertices)
+      {
+        int first = std::min_element(prism_vertices, prism_vertices+6) - prism_vertices;
+        viennagrid_int v[6];
+        for (int i = 0; i != 6; ++i)
+          v[i] = prism_vertices[ prism_permutations[first][i] ];
+
+        if ( std::min(v[1], v[5]) < std::min(v[2], v[4]) )
+        {
+          tetrahedron(v[0], v[1], v[2], v[5]);
+          tetrahedron(v[0], v[1], v[5], v[4]);
+        }
+        else
+        {
+          tetrahedron(v[0], v[1], v[2], v[4]);
+          tetrahedron(v[0], v[4], v[2], v[5]);
+        }
+        tetrahedron(v[0], v[4], v[5], v[3]);
+      }
+
+    private:
+      std::vector<viennagrid_int> & cells;
+    };
+
+
+    // Clips one cell which has vertices on both sides. vertices are the vertex
+    // indices of the cell, sides their sides and cuts the indices of the
+    // intersection points of the local edges, -1 for edges not cut.
+    void clip_cell(int vertices_per_cell,
+                   viennagrid_int const * vertices, int const * sides, viennagrid_int const * cuts,
+                   clip_cell_builder & builder)
+    {
+      if (vertices_per_cell == 3)
+      {
+        // walk around the triangle, keeping inner vertices and cut points
+        static int const ring_edges[3] = { 0, 2, 1 };
+        viennagrid_int polygon[4];
+        int count = 0;
+        for (int i = 0; i != 3; ++i)
+        {
+          if (sides[i] != outside)
+            polygon[count++] = vertices[i];
+          if (cuts[ring_edges[i]] != -1)
+            polygon[count++] = cuts[ring_edges[i]];
+        }
+        builder.polygon(polygon, count);
+        return;
+      }
+
+      int in[4], on[4], out[4];
+      int in_count = 0, on_count = 0, out_count = 0;
+      for (int i = 0; i != 4; ++i)
+      {
+        if (sides[i] == inside)
+          in[in_count++] = i;
+        else if (sides[i] == on_plane)
+          on[on_count++] = i;
+        else
+          out[out_count++] = i;
+      }
+
+      // cut point of the edge between local vertices i and j
+      viennagrid_int cut[4][4];
+      for (int e = 0; e != 6; ++e)
+      {
+        cut[ tetrahedron_edges[e][0] ][ tetrahedron_edges[e][1] ] = cuts[e];
+        cut[ tetrahedron_edges[e][1] ][ tetrahedron_edges[e][0] ] = cuts[e];
+      }
+
+      if (in_count == 1)
+      {
+        // a tetrahedron from the inner vertex, the vertices on the plane and the cut points
+        viennagrid_int tet[4];
+        int count = 0;
+        tet[count++] = vertices[in[0]];
+        for (int i = 0; i != on_count; ++i)
+          tet[count++] = vertices[on[i]];
+        for (int i = 0; i != out_count; ++i)
+          tet[count++] = cut[in[0]][out[i]];
+        builder.tetrahedron(tet[0], tet[1], tet[2], tet[3]);
+      }
+      else if (in_count == 2 && out_count == 2)
+      {
+        int a = in[0], b = in[1], c = out[0], d = out[1];
+        viennagrid_int prism[6] = { vertices[a], cut[a][c], cut[a][d],
+                                    vertices[b], cut[b][c], cut[b][d] };
+        builder.prism(prism);
+      }
+      else if (in_count == 2)
+      {
+        int a = in[0], b = in[1], d = out[0];
+        builder.pyramid( vertices[a], vertices[b], cut[b][d], cut[a][d], vertices[on[0]] );
+      }
+      else
+      {
+        int a = in[0], b = in[1], c = in[2], d = out[0];
+        viennagrid_int prism[6] = { vertices[a], vertices[b], vertices[c],
+                                    cut[a][d], cut[b][d], cut[c][d] };
+        builder.prism(prism);
+      }
+    }
+
+
+    // Clips the mesh at the hyperplane, keeping the part on the opposite side
+    // of the normal. Vertices within tolerance times their distance to the
+    // hyperplane point are on the hyperplane. Each cut edge gets one
+    // intersection point, which becomes vertex vertex_count + cut index.
+    void clip_at_hyperplane(simplex_mesh & mesh,
+                            std::vector<viennagrid_numeric> const & hyperplane_point,
+                            std::vector<viennagrid_numeric> const & hyperplane_normal,
+                            double tolerance)
+    {
+      int geometric_dimension = mesh.geometric_dimension;
+      int vertices_per_cell = mesh.vertices_per_cell;
+      int edges_per_cell = (vertices_per_cell == 3) ? 3 : 6;
+      int const (*cell_edges_local)[2] = (vertices_per_cell == 3) ? triangle_edges : tetrahedron_edges;
+
+      viennagrid_int vertex_count = mesh.vertex_count();
+      viennagrid_int cell_count = mesh.cell_count();
+
+      std::vector<viennagrid_numeric> distances(vertex_count);
+      std::vector<int> sides(vertex_count);
+#ifdef VIENNAMESH_WITH_OPENMP
+      #pragma omp parallel for
+#endif
+      for (viennagrid_int v = 0; v < vertex_count; ++v)
+      {
+        viennagrid_numeric const * p = &mesh.coords[v*geometric_dimension];
+        double distance = 0;
+        double length = 0;
+        for (int d = 0; d != geometric_dimension; ++d)
+        {
+          distance += hyperplane_normal[d] * (p[d] - hyperplane_point[d]);
+          length += (p[d] - hyperplane_point[d]) * (p[d] - hyperplane_point[d]);
+        }
+
+        double threshold = tolerance * std::sqrt(length);
+        distances[v] = distance;
+        sides[v] = (distance < -threshold) ? inside : (distance > threshold) ? outside : on_plane;
+      }
+
+
+      // cut cells have vertices on both sides, their edges between the sides are numbered
+      std::vector<char> cell_cut(cell_count);
+      std::vector<viennagrid_int> slot_counts(cell_count+1, 0);
+#ifdef VIENNAMESH_WITH_OPENMP
+      #pragma omp parallel for
+#endif
+      for (viennagrid_int cell = 0; cell < cell_count; ++cell)
+      {
+        viennagrid_int const * vertices = &mesh.cell_vertices[cell*vertices_per_cell];
+        for (int e = 0; e != edges_per_cell; ++e)
+        {
+          if ( sides[vertices[cell_edges_local[e][0]]] * sides[vertices[cell_edges_local[e][1]]] < 0 )
+            ++slot_counts[cell+1];
+        }
+        cell_cut[cell] = (slot_counts[cell+1] != 0);
+      }
+
+      for (viennagrid_int cell = 0; cell != cell_count; ++cell)
+        slot_counts[cell+1] += slot_counts[cell];
+
+      std::vector<viennagrid_int> cell_cuts( cell_count * edges_per_cell, -1 );
+      std::vector<edge_slot> slots( slot_counts[cell_count] );
+#ifdef VIENNAMESH_WITH_OPENMP
+      #pragma omp parallel for
+#endif
+      for (viennagrid_int cell = 0; cell < cell_count; ++cell)
+      {
+        viennagrid_int const * vertices = &mesh.cell_vertices[cell*vertices_per_cell];
+        viennagrid_int next = slot_counts[cell];
+        for (int e = 0; e != edges_per_cell; ++e)
+        {
+          viennagrid_int v0 = vertices[cell_edges_local[e][0]];
+          viennagrid_int v1 = vertices[cell_edges_local[e][1]];
+          if (sides[v0] * sides[v1] < 0)
+            slots[next++] = edge_slot( v0, v1, cell*edges_per_cell + e );
+        }
+      }
+
+      std::vector<viennagrid_int> cut_edges;
+      number_edges( slots, cell_cuts, cut_edges );
+
+      viennagrid_int cut_count = cut_edges.size()/2;
+#ifdef VIENNAMESH_WITH_OPENMP
+      #pragma omp parallel for
+#endif
+      for (long i = 0; i < static_cast<long>(cell_cuts.size()); ++i)
+      {
+        if (cell_cuts[i] != -1)
+          cell_cuts[i] += vertex_count;
+      }
+
+      mesh.coords.resize( (vertex_count + cut_count) * geometric_dimension );
+#ifdef VIENNAMESH_WITH_OPENMP
+      #pragma omp parallel for
+#endif
+      for (viennagrid_int i = 0; i < cut_count; ++i)
+      {
+        viennagrid_int v0 = cut_edges[2*i];
+        viennagrid_int v1 = cut_edges[2*i+1];
+        double t = distances[v0] / (distances[v0] - distances[v1]);
+
+        viennagrid_numeric const * p0 = &mesh.coords[v0*geometric_dimension];
+        viennagrid_numeric const * p1 = &mesh.coords[v1*geometric_dimension];
+        viennagrid_numeric * p = &mesh.coords[(vertex_count + i)*geometric_dimension];
+        for (int d = 0; d != geometric_dimension; ++d)
+          p[d] = p0[d] + t * (p1[d] - p0[d]);
+      }
+
+
+      // the kept cells in chunks, one chunk per thread in cell order
+      int chunk_count = thread_count();
+      std::vector< std::vector<viennagrid_int> > chunk_cells(chunk_count);
+      std::vector< std::vector<viennagrid_int> > chunk_parents(chunk_count);
+
+#ifdef VIENNAMESH_WITH_OPENMP
+      #pragma omp parallel for schedule(static, 1)
+#endif
+      for (int chunk = 0; chunk < chunk_count; ++chunk)
+      {
+        std::vector<viennagrid_int> & cells = chunk_cells[chunk];
+        std::vector<viennagrid_int> & parents = chunk_parents[chunk];
+        clip_cell_builder builder(cells);
+
+        viennagrid_int begin = static_cast<long>(cell_count) * chunk / chunk_count;
+        viennagrid_int end = static_cast<long>(cell_count) * (chunk+1) / chunk_count;
+        for (viennagrid_int cell = begin; cell != end; ++cell)
+        {
+          viennagrid_int const * vertices = &mesh.cell_vertices[cell*vertices_per_cell];
+          int cell_sides[4];
+          bool has_inside = false;
+          for (int i = 0; i != vertices_per_cell; ++i)
+          {
+            cell_sides[i] = sides[vertices[i]];
+            has_inside = has_inside || (cell_sides[i] == inside);
+          }
+
+          if (!has_inside)
+            continue;
+
+          std::size_t first = cells.size();
+          if (!cell_cut[cell])
+            cells.insert( cells.end(), vertices, vertices + vertices_per_cell );
+          else
+            clip_cell( vertices_per_cell, vertices, cell_sides, &cell_cuts[cell*edges_per_cell], builder );
+
+          parents.insert( parents.end(), (cells.size()-first) / vertices_per_cell, cell );
+        }
+      }
+
+
+      // only vertices of kept cells remain
+      std::vector<viennagrid_int> cell_vertices;
+      std::vector<viennagrid_int> cell_region_offsets(1, 0);
+      std::vector<viennagrid_region_id> cell_regions;
+      for (int chunk = 0; chunk != chunk_count; ++chunk)
+      {
+        std::vector<viennagrid_int> const & cells = chunk_cells[chunk];
+        std::vector<viennagrid_int> const & parents = chunk_parents[chunk];
+
+        cell_vertices.insert( cell_vertices.end(), cells.begin(), cells.end() );
+
+        for (std::size_t i = 0; i != parents.size(); ++i)
+        {
+          cell_regions.insert( cell_regions.end(),
+                               mesh.cell_regions.begin() + mesh.cell_region_offsets[parents[i]],
+                               mesh.cell_regions.begin() + mesh.cell_region_offsets[parents[i]+1] );
+          cell_region_offsets.push_back( cell_regions.size() );
+        }
+      }
+
+      mesh.cell_vertices.swap(cell_vertices);
+      mesh.cell_region_offsets.swap(cell_region_offsets);
+      mesh.cell_regions.swap(cell_regions);
+      compact_vertices(mesh);
+    }
+  }
+
   template<typename PointT, typename NumericConfigT>
   bool on_positive_hyperplane_side( PointT const & hyperplane_point, PointT const & hyperplane_normal,
                                     PointT const & to_test,
@@ -86,12 +428,33 @@ namespace viennamesh
     info(1) << "Hyperplane point: " << hyperplane_point << std::endl;
     info(1) << "Hyperplane normal: " << hyperplane_normal << std::endl;
 
-    mesh_handle tmp = make_data<mesh_handle>();
     mesh_handle output_mesh = make_data<mesh_handle>();
 
-    viennagrid::hyperplane_refine(input_mesh(), hyperplane_point, hyperplane_normal, 1e-8, tmp() );
-    viennagrid::copy( tmp(), output_mesh(),
-                      on_positive_hyperplane_side_functor<point, double>(hyperplane_point, -hyperplane_normal, 1e-8) );
+    // triangle and tetrahedron meshes are clipped directly into the output,
+    // other meshes are refined at the hyperplane and the kept half is copied
+    simplex_mesh mesh;
+    if ( read_simplex_mesh(input_mesh(), viennagrid::cell_dimension(input_mesh()), mesh) &&
+         mesh.vertices_per_cell != 2 )
+    {
+      std::vector<viennagrid_numeric> plane_point(point_dimension);
+      std::vector<viennagrid_numeric> plane_normal(point_dimension);
+      for (int d = 0; d != point_dimension; ++d)
+      {
+        plane_point[d] = hyperplane_point[d];
+        plane_normal[d] = hyperplane_normal[d];
+      }
+
+      clip_at_hyperplane( mesh, plane_point, plane_normal, 1e-8 );
+      copy_regions( input_mesh(), output_mesh() );
+      make_simplex_mesh( mesh, output_mesh() );
+    }
+    else
+    {
+      mesh_handle tmp = make_data<mesh_handle>();
+      viennagrid::hyperplane_refine(input_mesh(), hyperplane_point, hyperplane_normal, 1e-8, tmp() );
+      viennagrid::copy( tmp(), output_mesh(),
+                        on_positive_hyperplane_side_functor<point, double>(hyperplane_point, -hyperplane_normal, 1e-8) );
+    }
 
     set_output( "mesh", output_mesh );
 
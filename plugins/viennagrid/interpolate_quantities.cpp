@@ -13,10 +13,257 @@
 =============================================================================== */
 
 #include "interpolate_quantities.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "viennagrid/algorithm/centroid.hpp"
 #include "viennagrid/algorithm/quantity_interpolate.hpp"
 
+#include "viennameshpp/simplex_mesh.hpp"
+
 namespace viennamesh
 {
+  namespace
+  {
+    // Uniform grid over the bounding box of the cells of a triangle mesh in 2D
+    // or a tetrahedron mesh in 3D, each grid bin holds the cells whose bounding
+    // box overlaps it. The grid has about one bin per cell.
+    class simplex_locator
+    {
+    public:
+
+      simplex_locator(simplex_mesh const & mesh_) : mesh(mesh_)
+      {
+        int geometric_dimension = mesh.geometric_dimension;
+        viennagrid_int cell_count = mesh.cell_count();
+
+        for (int d = 0; d != geometric_dimension; ++d)
+        {
+          box_min[d] = box_max[d] = mesh.coords.empty() ? 0 : mesh.coords[d];
+          for (std::size_t i = d; i < mesh.coords.size(); i += geometric_dimension)
+          {
+            box_min[d] = std::min(box_min[d], mesh.coords[i]);
+            box_max[d] = std::max(box_max[d], mesh.coords[i]);
+          }
+        }
+
+        int bins_per_dimension = std::max( 1, static_cast<int>(std::pow(static_cast<double>(cell_count), 1.0/geometric_dimension)) );
+        bin_count = 1;
+        for (int d = 0; d != 3; ++d)
+        {
+          bins[d] = (d < geometric_dimension) ? bins_per_dimension : 1;
+          double extent = (d < geometric_dimension) ? box_max[d] - box_min[d] : 0;
+          inverse_bin_size[d] = (extent > 0) ? bins[d] / extent : 0;
+          bin_count *= bins[d];
+        }
+
+        // two passes over the cells, counting and filling the bins
+        bin_offsets.resize( bin_count+1, 0 );
+        for (int pass = 0; pass != 2; ++pass)
+        {
+          std::vector<viennagrid_int> fill;
+          if (pass == 1)
+          {
+            for (long i = 0; i != bin_count; ++i)
+              bin_offsets[i+1] += bin_offsets[i];
+            bin_cells.resize( bin_offsets[bin_count] );
+            fill.assign( bin_offsets.begin(), bin_offsets.end()-1 );
+          }
+
+          for (viennagrid_int cell = 0; cell != cell_count; ++cell)
+          {
+            int lo[3], hi[3];
+            cell_bins(cell, lo, hi);
+            for (int i = lo[0]; i <= hi[0]; ++i)
+              for (int j = lo[1]; j <= hi[1]; ++j)
+                for (int k = lo[2]; k <= hi[2]; ++k)
+                {
+                  long bin = (static_cast<long>(i)*bins[1] + j)*bins[2] + k;
+                  if (pass == 0)
+                    ++bin_offsets[bin+1];
+                  else
+                    bin_cells[ fill[bin]++ ] = cell;
+                }
+          }
+        }
+      }
+
+      // Returns the cell containing p and its barycentric coordinates of p. If
+      // no cell of the bin of p contains p, the cell of that bin which p is
+      // closest to be inside is taken and the coordinates are clamped to it.
+      // Returns -1 if the bin of p is empty.
+      viennagrid_int locate(viennagrid_numeric const * p, double * barycentric) const
+      {
+        int geometric_dimension = mesh.geometric_dimension;
+
+        long bin = 0;
+        for (int d = 0; d != 3; ++d)
+          bin = bin*bins[d] + ((d < geometric_dimension) ? bin_index(d, p[d]) : 0);
+
+        viennagrid_int best = -1;
+        double best_min = 0;
+        double current[4];
+        for (viennagrid_int i = bin_offsets[bin]; i != bin_offsets[bin+1]; ++i)
+        {
+          viennagrid_int cell = bin_cells[i];
+          double current_min = barycentric_coordinates(cell, p, current);
+          if (best == -1 || current_min > best_min)
+          {
+            best = cell;
+            best_min = current_min;
+            std::copy( current, current + geometric_dimension+1, barycentric );
+          }
+          if (current_min >= -1e-10)
+            break;
+        }
+
+        if (best != -1 && best_min < 0)
+        {
+          double sum = 0;
+          for (int i = 0; i <= geometric_dimension; ++i)
+          {
+            barycentric[i] = std::max(barycentric[i], 0.0);
+            sum += barycentric[i];
+          }
+          for (int i = 0; i <= geometric_dimension; ++i)
+            barycentric[i] /= sum;
+        }
+
+        return best;
+      }
+
+    private:
+
+      int bin_index(int d, double x) const
+      {
+        int index = static_cast<int>( (x - box_min[d]) * inverse_bin_size[d] );
+        return std::min( std::max(index, 0), bins[d]-1 );
+      }
+
+      void cell_bins(viennagrid_int cell, int * lo, int * hi) const
+      {
+        int geometric_dimension = mesh.geometric_dimension;
+        for (int d = 0; d != 3; ++d)
+        {
+          lo[d] = hi[d] = 0;
+          if (d >= geometric_dimension)
+            continue;
+
+          double cell_min = 0, cell_max = 0;
+          for (int i = 0; i != geometric_dimension+1; ++i)
+          {
+            double x = mesh.coords[ mesh.cell_vertices[cell*(geometric_dimension+1) + i]*geometric_dimension + d ];
+            cell_min = (i == 0) ? x : std::min(cell_min, x);
+            cell_max = (i == 0) ? x : std::max(cell_max, x);
+          }
+          lo[d] = bin_index(d, cell_min);
+          hi[d] = bin_index(d, cell_max);
+        }
+      }
+
+      // barycentric coordinates of p in the cell, returns the smallest one
+      double barycentric_coordinates(viennagrid_int cell, viennagrid_numeric const * p, double * result) const
+      {
+        int geometric_dimension = mesh.geometric_dimension;
+        viennagrid_int const * vertices = &mesh.cell_vertices[cell*(geometric_dimension+1)];
+        viennagrid_numeric const * p0 = &mesh.coords[vertices[0]*geometric_dimension];
+
+        // columns are the edges from the first vertex, solved by Cramer's rule
+        double m[3][3] = { {1,0,0}, {0,1,0}, {0,0,1} };
+        double r[3] = { 0, 0, 0 };
+        for (int d = 0; d != geometric_dimension; ++d)
+        {
+          for (int i = 0; i != geometric_dimension; ++i)
+            m[d][i] = mesh.coords[vertices[i+1]*geometric_dimension + d] - p0[d];
+          r[d] = p[d] - p0[d];
+        }
+
+        double det = determinant(m);
+        if (det == 0)
+        {
+          for (int i = 0; i <= geometric_dimension; ++i)
+            result[i] = (i == 0) ? 1 : 0;
+          return -1e300;
+        }
+
+        double first = 1;
+        double smallest = 1;
+        for (int i = 0; i != geometric_dimension; ++i)
+        {
+          double column[3][3];
+          std::copy( &m[0][0], &m[0][0] + 9, &column[0][0] );
+          for (int d = 0; d != 3; ++d)
+            column[d][i] = r[d];
+
+          result[i+1] = determinant(column) / det;
+          first -= result[i+1];
+          smallest = std::min(smallest, result[i+1]);
+        }
+        result[0] = first;
+        return std::min(smallest, first);
+      }
+
+      static double determinant(double const (&m)[3][3])
+      {
+        return m[0][0]*(m[1][1]*m[2][2]-m[1][2]*m[2][1])
+             - m[0][1]*(m[1][0]*m[2][2]-m[1][2]*m[2][0])
+             + m[0][2]*(m[1][0]*m[2][1]-m[1][1]*m[2][0]);
+      }
+
+      simplex_mesh const & mesh;
+
+      double box_min[3];
+      double box_max[3];
+      int bins[3];
+      double inverse_bin_size[3];
+      long bin_count;
+
+      std::vector<viennagrid_int> bin_offsets;
+      std::vector<viennagrid_int> bin_cells;
+    };
+
+
+    // located source cell and barycentric coordinates of each destination point
+    struct point_locations
+    {
+      std::vector<viennagrid_int> cells;
+      std::vector<double> barycentric;
+    };
+
+    void locate_points(simplex_locator const & locator, int geometric_dimension,
+                       std::vector<viennagrid_numeric> const & points,
+                       point_locations & locations)
+    {
+      long point_count = points.size() / geometric_dimension;
+      locations.cells.resize(point_count);
+      locations.barycentric.resize(point_count * (geometric_dimension+1));
+
+#ifdef VIENNAMESH_WITH_OPENMP
+      #pragma omp parallel for schedule(dynamic, 1024)
+#endif
+      for (long i = 0; i < point_count; ++i)
+        locations.cells[i] = locator.locate( &points[i*geometric_dimension],
+                                             &locations.barycentric[i*(geometric_dimension+1)] );
+    }
+
+
+    // vertex field of dst_mesh interpolated by viennagrid, which searches the
+    // source cell of each vertex
+    viennagrid::quantity_field interpolate_vertex_field(viennagrid::mesh const & src_mesh,
+                                                        viennagrid::quantity_field const & src_qf,
+                                                        viennagrid::mesh const & dst_mesh)
+    {
+      viennagrid::quantity_field dst_qf( 0, src_qf.values_per_quantity(), src_qf.storage_layout() );
+      dst_qf.set_name( src_qf.get_name() );
+
+      viennagrid::interpolate_vertex_quantity( src_mesh, src_qf, dst_mesh, dst_qf, 0 );
+      return dst_qf;
+    }
+  }
+
+
 
   interpolate_quantities::interpolate_quantities() {}
   std::string interpolate_quantities::name() { return "interpolate_quantities"; }
@@ -29,13 +276,85 @@ namespace viennamesh
 
     quantity_field_handle src_quantity_fields = get_input<viennagrid_quantity_field>("quantities");
     quantity_field_handle dst_quantity_fields = make_data<viennagrid::quantity_field>();
-    dst_quantity_fields.resize( src_quantity_fields.size() );
 
+    // triangle and tetrahedron source meshes are searched with a grid, the
+    // destination vertices and cell centroids are located concurrently
+    simplex_mesh src;
+    if ( !read_simplex_mesh(src_mesh(), viennagrid::cell_dimension(src_mesh()), src) ||
+         src.geometric_dimension < 2 || src.vertices_per_cell != src.geometric_dimension+1 )
+    {
+      for (int i = 0; i != src_quantity_fields.size(); ++i)
+      {
+        viennagrid::quantity_field src_qf = src_quantity_fields(i);
+        if (src_qf.topologic_dimension() != 0)
+        {
+          info(1) << "Quantity field \"" << src_qf.get_name() << "\" has unsupported topologic dimension = " << (int)src_qf.topologic_dimension() << " -> skipping" << std::endl;
+          continue;
+        }
+
+        dst_quantity_fields.push_back( interpolate_vertex_field(src_mesh(), src_qf, dst_mesh()) );
+      }
+
+      set_output( "quantities", dst_quantity_fields );
+      return true;
+    }
+
+    typedef viennagrid::mesh                                                MeshType;
+    typedef viennagrid::result_of::point<MeshType>::type                    PointType;
+
+    typedef viennagrid::result_of::const_cell_range<MeshType>::type         ConstCellRangeType;
+    typedef viennagrid::result_of::iterator<ConstCellRangeType>::type       ConstCellIteratorType;
 
+    int geometric_dimension = src.geometric_dimension;
+    if ( viennagrid::geometric_dimension(dst_mesh()) != geometric_dimension )
+    {
+      error(1) << "Source and destination mesh have different geometric dimensions" << std::endl;
+      return false;
+    }
+
+    // only scalar fields are interpolated with the located points
+    viennagrid_dimension src_cell_dimension = viennagrid::cell_dimension( src_mesh() );
+    bool has_vertex_fields = false;
+    bool has_cell_fields = false;
     for (int i = 0; i != src_quantity_fields.size(); ++i)
     {
       viennagrid::quantity_field src_qf = src_quantity_fields(i);
-      if (src_qf.topologic_dimension() != 0)
+      if (src_qf.values_per_quantity() != 1)
+        continue;
+      has_vertex_fields = has_vertex_fields || (src_qf.topologic_dimension() == 0);
+      has_cell_fields = has_cell_fields || (src_qf.topologic_dimension() == src_cell_dimension);
+    }
+
+    simplex_locator locator(src);
+
+    point_locations vertex_locations;
+    if (has_vertex_fields)
+    {
+      std::vector<viennagrid_numeric> points;
+      read_vertex_coords( dst_mesh(), points );
+      locate_points( locator, geometric_dimension, points, vertex_locations );
+    }
+
+    point_locations cell_locations;
+    if (has_cell_fields)
+    {
+      ConstCellRangeType cells( dst_mesh() );
+      std::vector<viennagrid_numeric> points( cells.size() * geometric_dimension );
+      for (ConstCellIteratorType cit = cells.begin(); cit != cells.end(); ++cit)
+      {
+        PointType p = viennagrid::centroid(*cit);
+        viennagrid_int index = (*cit).id().index();
+        for (int d = 0; d != geometric_dimension; ++d)
+          points[index*geometric_dimension + d] = p[d];
+      }
+      locate_points( locator, geometric_dimension, points, cell_locations );
+    }
+
+
+    for (int i = 0; i != src_quantity_fields.size(); ++i)
+    {
+      viennagrid::quantity_field src_qf = src_quantity_fields(i);
+      if ( src_qf.topologic_dimension() != 0 && src_qf.topologic_dimension() != src_cell_dimension )
       {
         info(1) << "Quantity field \"" << src_qf.get_name() << "\" has unsupported topologic dimension = " << (int)src_qf.topologic_dimension() << " -> skipping" << std::endl;
         continue;
@@ -44,19 +363,73 @@ namespace viennamesh
       info(1) << "Found quantity field \"" << src_qf.get_name() << "\" with topologic dimension " << (int)src_qf.topologic_dimension() <<
       " and values dimension " << (int)src_qf.values_per_quantity() << std::endl;
 
-      viennagrid::quantity_field dst_qf( 0, src_qf.values_per_quantity(), src_qf.storage_layout() );
-      dst_qf.set_name( src_qf.get_name() );
+      // vector fields on vertices are interpolated by viennagrid
+      if (src_qf.values_per_quantity() != 1)
+      {
+        if (src_qf.topologic_dimension() == 0)
+          dst_quantity_fields.push_back( interpolate_vertex_field(src_mesh(), src_qf, dst_mesh()) );
+        else
+          info(1) << "Quantity field \"" << src_qf.get_name() << "\" is a vector field on cells -> skipping" << std::endl;
+        continue;
+      }
 
-      viennagrid::interpolate_vertex_quantity( src_mesh(), src_qf, dst_mesh(), dst_qf, 0 );
+      bool on_vertices = (src_qf.topologic_dimension() == 0);
+      point_locations const & locations = on_vertices ? vertex_locations : cell_locations;
+      long point_count = locations.cells.size();
 
-      dst_quantity_fields.set(i, dst_qf);
-    }
+      viennagrid_int src_count = on_vertices ? src.vertex_count() : src.cell_count();
+      std::vector<viennagrid_numeric> src_values(src_count);
+      std::vector<char> src_valid(src_count);
+      for (viennagrid_int j = 0; j != src_count; ++j)
+      {
+        src_valid[j] = src_qf.valid(j);
+        src_values[j] = src_valid[j] ? src_qf.get(j) : 0;
+      }
+
+      // vertex values are interpolated linearly in the source cell, cell values are constant
+      std::vector<viennagrid_numeric> values(point_count);
+      std::vector<char> valid(point_count);
+#ifdef VIENNAMESH_WITH_OPENMP
+      #pragma omp parallel for
+#endif
+      for (long j = 0; j < point_count; ++j)
+      {
+        viennagrid_int cell = locations.cells[j];
+        valid[j] = (cell != -1);
+        values[j] = 0;
+        if (!valid[j])
+          continue;
+
+        if (!on_vertices)
+        {
+          valid[j] = src_valid[cell];
+          values[j] = src_values[cell];
+          continue;
+        }
+
+        for (int k = 0; k <= geometric_dimension; ++k)
+        {
+          viennagrid_int vertex = src.cell_vertices[cell*(geometric_dimension+1) + k];
+          valid[j] = valid[j] && src_valid[vertex];
+          values[j] += locations.barycentric[j*(geometric_dimension+1) + k] * src_values[vertex];
+        }
+      }
 
+      viennagrid::quantity_field dst_qf;
+      dst_qf.init( on_vertices ? 0 : viennagrid::cell_dimension(dst_mesh()), 1 );
+      dst_qf.set_name( src_qf.get_name() );
+      for (long j = 0; j != point_count; ++j)
+      {
+        if (valid[j])
+          dst_qf.set( static_cast<viennagrid_int>(j), values[j] );
+      }
+
+      dst_quantity_fields.push_back(dst_qf);
+    }
 
     set_output( "quantities", dst_quantity_fields );
 
     return true;
   }
 
-
 }
@@ -185,12 +185,6 @@ namespace viennamesh
     if (!iteration_count.valid())
       return false;
 
-    mesh_handle output_mesh = make_data<mesh_handle>();
-
-    if (output_mesh != input_mesh)
-      viennagrid::copy( input_mesh(), output_mesh() );
-
-
     function< void(viennagrid::mesh const &) > smooth_function;
     if (geometric_dimension == 3 && cell_dimension == 2)
     {
@@ -210,6 +204,15 @@ namespace viennamesh
 
 //     typedef void (*hull_laplace_smooth_impl)(viennagrid::mesh_t const &, double) SmoothFunction
 
+    // without smoothing steps all coordinates stay unchanged, the input is shared
+    if (iteration_count() <= 0 || lambda() == 0.0)
+    {
+      set_output( "mesh", input_mesh );
+      return true;
+    }
+
+    mesh_handle output_mesh = make_coordinate_output( "mesh", input_mesh );
+
     for (int i = 0; i < iteration_count(); ++i)
       smooth_function( output_mesh() );
 
@@ -14,126 +14,170 @@
 
 #include "line_coarsening.hpp"
 
-#include "viennagrid/algorithm/angle.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "viennameshpp/simplex_mesh.hpp"
+#include "viennameshpp/union_find.hpp"
 
 
 namespace viennamesh
 {
-
-  template<typename ElementRangeT, typename AccessorT, typename T>
-  void merge_lines(ElementRangeT const & elements,
-                   AccessorT accessor,
-                   T from, T to)
+  namespace
   {
-    typedef typename viennagrid::result_of::const_iterator<ElementRangeT>::type ElementRangeIterator;
-    for (ElementRangeIterator eit = elements.begin(); eit != elements.end(); ++eit)
+    // lines of a mesh with the lines of each vertex
+    struct coarsening_lines : simplex_mesh
     {
-      if ( accessor.get(*eit) == from )
-        accessor.set(*eit, to);
-    }
+      std::vector<viennagrid_int> vertex_line_offsets;
+      std::vector<viennagrid_int> vertex_lines;
+
+      viennagrid_int degree(viennagrid_int vertex) const
+      { return vertex_line_offsets[vertex+1] - vertex_line_offsets[vertex]; }
+
+      viennagrid_int other_vertex(viennagrid_int line, viennagrid_int vertex) const
+      { return cell_vertices[2*line] == vertex ? cell_vertices[2*line+1] : cell_vertices[2*line]; }
+
+      // angle at vertex middle between the vertices first and last
+      double angle(viennagrid_int first, viennagrid_int last, viennagrid_int middle) const
+      {
+        double dot = 0, first_length = 0, last_length = 0;
+        for (int d = 0; d != geometric_dimension; ++d)
+        {
+          double u = coords[first*geometric_dimension + d] - coords[middle*geometric_dimension + d];
+          double v = coords[last*geometric_dimension + d] - coords[middle*geometric_dimension + d];
+          dot += u*v;
+          first_length += u*u;
+          last_length += v*v;
+        }
+        double c = dot / std::sqrt(first_length * last_length);
+        return std::acos( std::max(-1.0, std::min(1.0, c)) );
+      }
+    };
   }
 
 
 
-  template<typename MeshT>
-  void coarsen(MeshT const & mesh,
+  // Merges the two lines of each vertex with exactly two lines of the same
+  // regions if their angle at the vertex is larger than angle. Each set of
+  // merged lines is replaced by one line between its two end vertices, with
+  // the regions of its first line. Merged sets without two end vertices, like
+  // closed loops, keep their lines.
+  void coarsen(viennagrid::mesh const & mesh,
                viennagrid::mesh const & output_mesh,
                double angle)
   {
-    typedef typename viennagrid::result_of::element<MeshT>::type                  ElementType;
-
-    typedef typename viennagrid::result_of::element_range<MeshT>::type            ElementRangeType;
-    typedef typename viennagrid::result_of::iterator<ElementRangeType>::type      ElementIteratorType;
-
-
-
-    ElementRangeType lines(mesh, 1);
-
-
-
-    typedef std::vector<viennagrid::element_id> NewLineIDContainerType;
-    typedef typename viennagrid::result_of::accessor<NewLineIDContainerType, ElementType>::type NewLineIDAcessorType;
-
-    NewLineIDContainerType line_id_container( lines.size() );
-    NewLineIDAcessorType line_ids(line_id_container);
-
-    for (ElementIteratorType lit = lines.begin(); lit != lines.end(); ++lit)
-      line_ids.set(*lit, (*lit).id());
-
-
-
-    ElementRangeType vertices(mesh, 0);
-    for (ElementIteratorType vit = vertices.begin(); vit != vertices.end(); ++vit)
+    coarsening_lines lines;
+    read_simplex_mesh(mesh, 1, lines);
+    make_vertex_cells(lines, lines.vertex_line_offsets, lines.vertex_lines);
+
+    viennagrid_int vertex_count = lines.vertex_count();
+    viennagrid_int line_count = lines.cell_count();
+
+    // vertices where lines are merged
+    std::vector<char> merge_vertex(vertex_count, 0);
+#ifdef VIENNAMESH_WITH_OPENMP
+    #pragma omp parallel for
+#endif
+    for (viennagrid_int v = 0; v < vertex_count; ++v)
     {
-      typedef typename viennagrid::result_of::coboundary_range<MeshT>::type CoboundaryVertexRangeType;
-
-      CoboundaryVertexRangeType coboundary_lines(mesh, *vit, 1);
-      if (coboundary_lines.size() != 2)
+      if (lines.degree(v) != 2)
         continue;
 
-      if (!viennagrid::equal_regions(viennagrid::regions(coboundary_lines[0]),
-                                     viennagrid::regions(coboundary_lines[1])))
+      viennagrid_int l0 = lines.vertex_lines[ lines.vertex_line_offsets[v] ];
+      viennagrid_int l1 = lines.vertex_lines[ lines.vertex_line_offsets[v]+1 ];
+      if ( !lines.same_regions(l0, l1) )
         continue;
 
-      ElementType middle = (*vit);
-      ElementType first = viennagrid::vertices(coboundary_lines[0])[0] == middle ?
-                                viennagrid::vertices(coboundary_lines[0])[1] :
-                                viennagrid::vertices(coboundary_lines[0])[0];
-      ElementType last = viennagrid::vertices(coboundary_lines[1])[0] == middle ?
-                                viennagrid::vertices(coboundary_lines[1])[1] :
-                                viennagrid::vertices(coboundary_lines[1])[0];
+      merge_vertex[v] = lines.angle( lines.other_vertex(l0, v), lines.other_vertex(l1, v), v ) > angle;
+    }
+
+    union_find<viennagrid_int> merged_lines(line_count);
+    for (viennagrid_int v = 0; v != vertex_count; ++v)
+    {
+      if (merge_vertex[v])
+        merged_lines.unite( lines.vertex_lines[lines.vertex_line_offsets[v]],
+                            lines.vertex_lines[lines.vertex_line_offsets[v]+1] );
+    }
+
+    std::vector<viennagrid_int> line_set(line_count);
+    for (viennagrid_int l = 0; l != line_count; ++l)
+      line_set[l] = merged_lines.find(l);
 
 
-      double current_angle = viennagrid::angle( viennagrid::get_point(mesh, first),
-                                                viennagrid::get_point(mesh, last),
-                                                viennagrid::get_point(mesh, middle) );
-      if (current_angle > angle)
+    // a vertex of a line ends its set if no other line of the vertex is in the set
+    std::vector<char> line_ends( 2*line_count, 0 );
+#ifdef VIENNAMESH_WITH_OPENMP
+    #pragma omp parallel for
+#endif
+    for (viennagrid_int l = 0; l < line_count; ++l)
+    {
+      for (int k = 0; k != 2; ++k)
       {
-        merge_lines( lines,
-                     line_ids,
-                     line_ids.get(coboundary_lines[0]),
-                     line_ids.get(coboundary_lines[1]) );
+        viennagrid_int v = lines.cell_vertices[2*l+k];
+        bool end = true;
+        for (viennagrid_int i = lines.vertex_line_offsets[v]; i != lines.vertex_line_offsets[v+1]; ++i)
+        {
+          viennagrid_int other = lines.vertex_lines[i];
+          if (other != l && line_set[other] == line_set[l])
+            end = false;
+        }
+        line_ends[2*l+k] = end;
       }
-
     }
 
-
-    std::map<viennagrid::element_id, std::vector<ElementType> > new_lines;
-
-    for (ElementIteratorType lit = lines.begin(); lit != lines.end(); ++lit)
-      new_lines[line_ids.get(*lit)].push_back( *lit );
+    // the end vertices of each set, stored at its representative, the first line of the set
+    std::vector<viennagrid_int> set_ends( 2*line_count, -1 );
+    std::vector<int> set_end_count( line_count, 0 );
+    for (viennagrid_int l = 0; l != line_count; ++l)
+    {
+      viennagrid_int set = line_set[l];
+      for (int k = 0; k != 2; ++k)
+      {
+        if (!line_ends[2*l+k])
+          continue;
+        if (set_end_count[set] < 2)
+          set_ends[2*set + set_end_count[set]] = lines.cell_vertices[2*l+k];
+        ++set_end_count[set];
+      }
+    }
 
 
-    typedef typename viennagrid::result_of::element_copy_map<>::type CopyMapType;
-    CopyMapType copy_map( output_mesh, false );
+    // output lines with the regions of their source line, vertices are
+    // created in the order of their first use
+    simplex_mesh output_lines;
+    output_lines.geometric_dimension = lines.geometric_dimension;
+    output_lines.vertices_per_cell = 2;
+    output_lines.cell_region_offsets.push_back(0);
 
-    for (typename std::map<viennagrid::element_id, std::vector<ElementType> >::iterator nlit = new_lines.begin(); nlit != new_lines.end(); ++nlit)
+    for (viennagrid_int l = 0; l != line_count; ++l)
     {
-      std::map<ElementType, int> points;
+      viennagrid_int set = line_set[l];
+      if (set_end_count[set] == 2 && set != l)
+        continue;
 
-      for (std::size_t i = 0; i != (*nlit).second.size(); ++i)
+      if (set_end_count[set] != 2)
       {
-        points[ viennagrid::vertices((*nlit).second[i])[0] ]++;
-        points[ viennagrid::vertices((*nlit).second[i])[1] ]++;
+        output_lines.cell_vertices.push_back( lines.cell_vertices[2*l] );
+        output_lines.cell_vertices.push_back( lines.cell_vertices[2*l+1] );
       }
-
-      std::vector<ElementType> line_to_create;
-
-      for (typename std::map<ElementType, int>::iterator pit = points.begin(); pit != points.end(); ++pit)
+      else
       {
-        if ((*pit).second == 1)
-          line_to_create.push_back( (*pit).first );
+        output_lines.cell_vertices.push_back( set_ends[2*set] );
+        output_lines.cell_vertices.push_back( set_ends[2*set+1] );
       }
 
-      assert( line_to_create.size() == 2 );
-
-      ElementType nv0 = copy_map( line_to_create[0] );
-      ElementType nv1 = copy_map( line_to_create[1] );
+      output_lines.cell_regions.insert( output_lines.cell_regions.end(),
+                                        lines.cell_regions.begin() + lines.cell_region_offsets[l],
+                                        lines.cell_regions.begin() + lines.cell_region_offsets[l+1] );
+      output_lines.cell_region_offsets.push_back( output_lines.cell_regions.size() );
+    }
 
-      ElementType nl = viennagrid::make_line(output_mesh, nv0, nv1);
+    output_lines.coords.swap(lines.coords);
+    compact_vertices(output_lines);
 
-      viennagrid::copy_region_information((*nlit).second[0], nl);
-    }
+    copy_regions(mesh, output_mesh);
+    make_simplex_mesh(output_lines, output_mesh);
   }
 
 
@@ -14,7 +14,8 @@
 
 #include "map_regions.hpp"
 #include "boost/algorithm/string.hpp"
-#include <set>
+#include <algorithm>
+#include <vector>
 
 namespace viennamesh
 {
@@ -38,35 +39,68 @@ namespace viennamesh
 
     typedef typename viennagrid::result_of::element<DstMeshType>::type            CellType;
 
-    std::map<SrcRegionIDType, std::string> region_id_name_map;
+    typedef typename viennagrid::result_of::region<DstMeshType>::type             DstRegionType;
+
     std::map<std::string, DstRegionIDType> region_name_id_map;
+    SrcRegionIDType max_region_id = -1;
 
     SrcRegionRangeType src_regions(src_mesh);
     for (SrcRegionRangeIterator rit = src_regions.begin(); rit != src_regions.end(); ++rit)
     {
-      region_id_name_map[ (*rit).id() ]   = (*rit).get_name();
       region_name_id_map[ (*rit).get_name() ] = (*rit).id();
+      max_region_id = std::max( max_region_id, (*rit).id() );
     }
 
+    // destination region id of each source region id, resolved once per region
+    std::vector<DstRegionIDType> region_id_translation( max_region_id+1 );
+    for (SrcRegionRangeIterator rit = src_regions.begin(); rit != src_regions.end(); ++rit)
+    {
+      typename SegmentIDMapT::const_iterator dst_region_id_it = region_id_map.find( (*rit).get_name() );
+      if (dst_region_id_it != region_id_map.end())
+        region_id_translation[ (*rit).id() ] = region_name_id_map[dst_region_id_it->second];
+      else
+        region_id_translation[ (*rit).id() ] = (*rit).id();
+    }
+
+    // destination regions by id, created on first use like before
+    std::vector<DstRegionType> dst_regions;
+    std::vector<bool> dst_region_valid;
+
+    std::vector<DstRegionIDType> dst_region_ids;
 
     ConstCellRangeType cells(src_mesh);
     for (ConstCellIteratorType cit = cells.begin(); cit != cells.end(); ++cit)
     {
       CellType cell = copy_map(*cit );
-      std::set<DstRegionIDType> dst_region_ids;
 
+      // a cell is only in a few regions, a linear search removes duplicates
+      dst_region_ids.clear();
       SrcRegionRangeType element_regions(*cit);
       for (SrcRegionRangeIterator rit = element_regions.begin(); rit != element_regions.end(); ++rit)
       {
-        typename SegmentIDMapT::const_iterator dst_region_id_it = region_id_map.find( region_id_name_map[(*rit).id()] );
-        if (dst_region_id_it != region_id_map.end())
-          dst_region_ids.insert( region_name_id_map[dst_region_id_it->second] );
-        else
-          dst_region_ids.insert( (*rit).id() );
+        DstRegionIDType dst_region_id = region_id_translation[ (*rit).id() ];
+        if (std::find(dst_region_ids.begin(), dst_region_ids.end(), dst_region_id) == dst_region_ids.end())
+          dst_region_ids.push_back(dst_region_id);
       }
+      std::sort( dst_region_ids.begin(), dst_region_ids.end() );
+
+      for (std::size_t i = 0; i != dst_region_ids.size(); ++i)
+      {
+        DstRegionIDType dst_region_id = dst_region_ids[i];
+        if (dst_region_id >= static_cast<DstRegionIDType>(dst_regions.size()))
+        {
+          dst_regions.resize( dst_region_id+1 );
+          dst_region_valid.resize( dst_region_id+1, false );
+        }
 
-      for (typename std::set<DstRegionIDType>::const_iterator dst_region_id_it = dst_region_ids.begin(); dst_region_id_it != dst_region_ids.end(); ++dst_region_id_it)
-        viennagrid::add( dst_mesh.get_or_create_region(*dst_region_id_it), cell );
+        if (!dst_region_valid[dst_region_id])
+        {
+          dst_regions[dst_region_id] = dst_mesh.get_or_create_region(dst_region_id);
+          dst_region_valid[dst_region_id] = true;
+        }
+
+        viennagrid::add( dst_regions[dst_region_id], cell );
+      }
     }
   }
 
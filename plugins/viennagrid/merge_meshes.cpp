@@ -14,41 +14,393 @@
 
 #include "merge_meshes.hpp"
 
+#include <set>
+#include <cmath>
+#include <algorithm>
+#include <boost/unordered_map.hpp>
+
 namespace viennamesh
 {
-  template<bool mesh_is_const>
-  void merge_meshes_impl(viennagrid::base_mesh<mesh_is_const> const & src_mesh,
-                         viennagrid::mesh const & dst_mesh,
-                         double tolerance, bool region_offset)
+  // flat copy of a mesh which can be welded with other chunks without touching viennagrid
+  struct merge_mesh_chunk
   {
-    viennagrid::result_of::element_copy_map<>::type copy_map(dst_mesh, tolerance, false);
+    std::vector<viennagrid_numeric> coords;
+
+    std::vector<viennagrid_element_type> cell_types;
+    std::vector<viennagrid_int> cell_vertex_offsets;
+    std::vector<viennagrid_int> cell_vertices;
+
+    std::vector<viennagrid_int> cell_region_offsets;
+    std::vector<viennagrid_region_id> cell_regions;
+
+    void release()
+    {
+      std::vector<viennagrid_numeric>().swap(coords);
+      std::vector<viennagrid_element_type>().swap(cell_types);
+      std::vector<viennagrid_int>().swap(cell_vertex_offsets);
+      std::vector<viennagrid_int>().swap(cell_vertices);
+      std::vector<viennagrid_int>().swap(cell_region_offsets);
+      std::vector<viennagrid_region_id>().swap(cell_regions);
+    }
+  };
+
 
+  template<bool mesh_is_const>
+  void extract_merge_chunk(viennagrid::base_mesh<mesh_is_const> const & src_mesh,
+                           int geometric_dimension,
+                           int region_id_offset,
+                           merge_mesh_chunk & chunk)
+  {
     typedef viennagrid::base_mesh<mesh_is_const>                                    SrcMeshType;
 
-    typedef typename viennagrid::result_of::element<SrcMeshType>::type              CellType;
+    typedef typename viennagrid::result_of::point<SrcMeshType>::type                PointType;
+    typedef typename viennagrid::result_of::element<SrcMeshType>::type              ElementType;
+
+    typedef typename viennagrid::result_of::const_vertex_range<SrcMeshType>::type   ConstVertexRangeType;
+    typedef typename viennagrid::result_of::iterator<ConstVertexRangeType>::type    ConstVertexIteratorType;
 
     typedef typename viennagrid::result_of::const_cell_range<SrcMeshType>::type     ConstCellRangeType;
     typedef typename viennagrid::result_of::iterator<ConstCellRangeType>::type      ConstCellIteratorType;
 
+    typedef typename viennagrid::result_of::const_element_range<ElementType>::type  ConstBoundaryRangeType;
+    typedef typename viennagrid::result_of::iterator<ConstBoundaryRangeType>::type  ConstBoundaryIteratorType;
+
     typedef typename viennagrid::result_of::region_range<SrcMeshType>::type         SrcRegionRangeType;
     typedef typename viennagrid::result_of::iterator<SrcRegionRangeType>::type      SrcRegionRangeIterator;
 
-    int region_id_offset = dst_mesh.region_count();
     int source_region_count = src_mesh.region_count();
 
+    ConstVertexRangeType vertices(src_mesh);
+    chunk.coords.resize( vertices.size() * geometric_dimension );
+    for (ConstVertexIteratorType vit = vertices.begin(); vit != vertices.end(); ++vit)
+    {
+      PointType p = viennagrid::get_point(*vit);
+      viennagrid_int index = (*vit).id().index();
+      for (int d = 0; d != geometric_dimension; ++d)
+        chunk.coords[index*geometric_dimension + d] = p[d];
+    }
+
     ConstCellRangeType cells(src_mesh);
+    chunk.cell_types.reserve( cells.size() );
+    chunk.cell_vertex_offsets.reserve( cells.size()+1 );
+    chunk.cell_region_offsets.reserve( cells.size()+1 );
+
+    chunk.cell_vertex_offsets.push_back(0);
+    chunk.cell_region_offsets.push_back(0);
+
     for (ConstCellIteratorType cit = cells.begin(); cit != cells.end(); ++cit)
     {
-      CellType cell = copy_map(*cit);
+      chunk.cell_types.push_back( (*cit).tag().internal() );
+
+      ConstBoundaryRangeType cell_vertices(*cit, 0);
+      for (ConstBoundaryIteratorType vit = cell_vertices.begin(); vit != cell_vertices.end(); ++vit)
+        chunk.cell_vertices.push_back( (*vit).id().index() );
+      chunk.cell_vertex_offsets.push_back( chunk.cell_vertices.size() );
 
       if (source_region_count <= 1)
-        viennagrid::add( dst_mesh.get_or_create_region(region_offset ? region_id_offset : 0), cell );
+        chunk.cell_regions.push_back( region_id_offset );
       else
       {
         SrcRegionRangeType region_range(*cit);
         for (SrcRegionRangeIterator rit = region_range.begin(); rit != region_range.end(); ++rit)
+          chunk.cell_regions.push_back( (*rit).id() + region_id_offset );
+      }
+      chunk.cell_region_offsets.push_back( chunk.cell_regions.size() );
+    }
+  }
+
+
+
+  // spatial hash grid with cell size = tolerance, a vertex within tolerance of a query point
+  // is always located in one of the 3^dim grid cells around the query point
+  class vertex_weld_grid
+  {
+  public:
+
+    vertex_weld_grid(std::vector<viennagrid_numeric> const & coords_,
+                     int geometric_dimension_, double tolerance_) :
+        coords(coords_), geometric_dimension(geometric_dimension_), tolerance(tolerance_)
+    {
+      inverse_cell_size = (tolerance > 0) ? 1.0/tolerance : 1.0;
+
+      viennagrid_int vertex_count = coords.size() / geometric_dimension;
+      next.resize(vertex_count, -1);
+      heads.rehash( vertex_count );
+
+      // insert in reverse order, chains are then sorted by ascending vertex index
+      for (viennagrid_int i = vertex_count-1; i >= 0; --i)
+      {
+        std::pair<HeadMapType::iterator, bool> result = heads.insert( std::make_pair(key(&coords[i*geometric_dimension]), i) );
+        if (!result.second)
         {
-          viennagrid::add( dst_mesh.get_or_create_region((*rit).id() + (region_offset ? region_id_offset : 0)), cell );
+          next[i] = result.first->second;
+          result.first->second = i;
+        }
+      }
+    }
+
+    // returns the smallest index of a vertex within tolerance of p or -1
+    viennagrid_int find(viennagrid_numeric const * p) const
+    {
+      cell_key center = key(p);
+      viennagrid_int best = -1;
+
+      long range[3];
+      for (int d = 0; d != 3; ++d)
+        range[d] = (d < geometric_dimension) ? 1 : 0;
+
+      for (long i = -range[0]; i <= range[0]; ++i)
+        for (long j = -range[1]; j <= range[1]; ++j)
+          for (long k = -range[2]; k <= range[2]; ++k)
+          {
+            cell_key neighbor = center;
+            neighbor.c[0] += i;
+            neighbor.c[1] += j;
+            neighbor.c[2] += k;
+
+            HeadMapType::const_iterator it = heads.find(neighbor);
+            if (it == heads.end())
+              continue;
+
+            for (viennagrid_int v = it->second; v != -1; v = next[v])
+            {
+              if (best != -1 && v > best)
+                break;
+
+              if (squared_distance(p, &coords[v*geometric_dimension]) <= tolerance*tolerance)
+              {
+                best = v;
+                break;
+              }
+            }
+          }
+
+      return best;
+    }
+
+  private:
+
+    struct cell_key
+    {
+      long c[3];
+
+      bool operator==(cell_key const & other) const
+      { return c[0] == other.c[0] && c[1] == other.c[1] && c[2] == other.c[2]; }
+    };
+
+    struct cell_key_hash
+    {
+      std::size_t operator()(cell_key const & k) const
+      {
+        std::size_t seed = 0;
+        boost::hash_combine(seed, k.c[0]);
+        boost::hash_combine(seed, k.c[1]);
+        boost::hash_combine(seed, k.c[2]);
+        return seed;
+      }
+    };
+
+    typedef boost::unordered_map<cell_key, viennagrid_int, cell_key_hash> HeadMapType;
+
+    cell_key key(viennagrid_numeric const * p) const
+    {
+      cell_key k;
+      for (int d = 0; d != 3; ++d)
+        k.c[d] = (d < geometric_dimension) ? static_cast<long>(std::floor(p[d] * inverse_cell_size)) : 0;
+      return k;
+    }
+
+    double squared_distance(viennagrid_numeric const * p, viennagrid_numeric const * q) const
+    {
+      double result = 0;
+      for (int d = 0; d != geometric_dimension; ++d)
+        result += (p[d]-q[d])*(p[d]-q[d]);
+      return result;
+    }
+
+    std::vector<viennagrid_numeric> const & coords;
+    int geometric_dimension;
+    double tolerance;
+    double inverse_cell_size;
+
+    HeadMapType heads;
+    std::vector<viennagrid_int> next;
+  };
+
+
+
+  // welds the vertices of one chunk within tolerance to the first vertex of the chunk
+  // close to them, a negative tolerance disables welding
+  void weld_chunk_vertices(merge_mesh_chunk & chunk, int geometric_dimension, double tolerance)
+  {
+    viennagrid_int vertex_count = chunk.coords.size() / geometric_dimension;
+    if (tolerance < 0 || vertex_count == 0)
+      return;
+
+    std::vector<viennagrid_int> vertex_map(vertex_count);
+    std::vector<char> welded(vertex_count, false);
+    viennagrid_int new_vertex_index = 0;
+    {
+      vertex_weld_grid grid(chunk.coords, geometric_dimension, tolerance);
+      for (viennagrid_int i = 0; i != vertex_count; ++i)
+      {
+        viennagrid_int first = grid.find( &chunk.coords[i*geometric_dimension] );
+        welded[i] = (first != -1 && first < i);
+        vertex_map[i] = welded[i] ? vertex_map[first] : new_vertex_index++;
+      }
+    }
+
+    if (new_vertex_index == vertex_count)
+      return;
+
+    // kept vertices only move to lower indices
+    for (viennagrid_int i = 0; i != vertex_count; ++i)
+    {
+      if (welded[i])
+        continue;
+      for (int d = 0; d != geometric_dimension; ++d)
+        chunk.coords[vertex_map[i]*geometric_dimension + d] = chunk.coords[i*geometric_dimension + d];
+    }
+    chunk.coords.resize( new_vertex_index*geometric_dimension );
+
+    for (std::size_t i = 0; i != chunk.cell_vertices.size(); ++i)
+      chunk.cell_vertices[i] = vertex_map[ chunk.cell_vertices[i] ];
+  }
+
+
+
+  // appends src to dst, vertices of src within tolerance of a vertex of dst are welded,
+  // a negative tolerance disables welding
+  void weld_merge_chunk(merge_mesh_chunk & dst, merge_mesh_chunk const & src,
+                        int geometric_dimension, double tolerance)
+  {
+    viennagrid_int dst_vertex_count = dst.coords.size() / geometric_dimension;
+    viennagrid_int src_vertex_count = src.coords.size() / geometric_dimension;
+
+    std::vector<viennagrid_int> vertex_map(src_vertex_count, -1);
+    if (tolerance >= 0 && dst_vertex_count > 0)
+    {
+      vertex_weld_grid grid(dst.coords, geometric_dimension, tolerance);
+      for (viennagrid_int i = 0; i != src_vertex_count; ++i)
+        vertex_map[i] = grid.find( &src.coords[i*geometric_dimension] );
+    }
+
+    viennagrid_int new_vertex_index = dst_vertex_count;
+    for (viennagrid_int i = 0; i != src_vertex_count; ++i)
+    {
+      if (vertex_map[i] != -1)
+        continue;
+
+      vertex_map[i] = new_vertex_index++;
+      dst.coords.insert( dst.coords.end(),
+                         src.coords.begin() + i*geometric_dimension,
+                         src.coords.begin() + (i+1)*geometric_dimension );
+    }
+
+    if (dst.cell_vertex_offsets.empty())
+      dst.cell_vertex_offsets.push_back(0);
+    if (dst.cell_region_offsets.empty())
+      dst.cell_region_offsets.push_back(0);
+
+    viennagrid_int vertex_offset = dst.cell_vertices.size();
+    viennagrid_int region_offset = dst.cell_regions.size();
+
+    dst.cell_types.insert( dst.cell_types.end(), src.cell_types.begin(), src.cell_types.end() );
+    dst.cell_regions.insert( dst.cell_regions.end(), src.cell_regions.begin(), src.cell_regions.end() );
+
+    dst.cell_vertices.reserve( dst.cell_vertices.size() + src.cell_vertices.size() );
+    for (std::size_t i = 0; i != src.cell_vertices.size(); ++i)
+      dst.cell_vertices.push_back( vertex_map[src.cell_vertices[i]] );
+
+    for (std::size_t i = 1; i < src.cell_vertex_offsets.size(); ++i)
+      dst.cell_vertex_offsets.push_back( src.cell_vertex_offsets[i] + vertex_offset );
+    for (std::size_t i = 1; i < src.cell_region_offsets.size(); ++i)
+      dst.cell_region_offsets.push_back( src.cell_region_offsets[i] + region_offset );
+  }
+
+
+
+  // merges the chunks pairwise in a tree reduction, neighbouring chunks are merged in
+  // each level so the resulting vertex and cell order equals the order of the inputs.
+  // A vertex is welded to the chunks before it level by level instead of to all
+  // previous meshes at once, as matching within tolerance is not transitive a chain of
+  // close vertices can be welded differently than by merging the meshes one by one.
+  void reduce_merge_chunks(std::vector<merge_mesh_chunk> & chunks,
+                           int geometric_dimension, double tolerance)
+  {
+    long chunk_count = chunks.size();
+    for (long stride = 1; stride < chunk_count; stride *= 2)
+    {
+#ifdef VIENNAMESH_WITH_OPENMP
+      #pragma omp parallel for schedule(dynamic)
+#endif
+      for (long i = 0; i < chunk_count; i += 2*stride)
+      {
+        if (i + stride < chunk_count)
+        {
+          weld_merge_chunk( chunks[i], chunks[i+stride], geometric_dimension, tolerance );
+          chunks[i+stride].release();
+        }
+      }
+    }
+  }
+
+
+
+  void make_merged_mesh(merge_mesh_chunk & chunk, int geometric_dimension,
+                        viennagrid::mesh const & dst_mesh)
+  {
+    typedef viennagrid::mesh                                        MeshType;
+    typedef viennagrid::result_of::point<MeshType>::type            PointType;
+    typedef viennagrid::result_of::element<MeshType>::type          ElementType;
+
+    viennagrid_int vertex_count = chunk.coords.size() / geometric_dimension;
+    viennagrid_int cell_count = chunk.cell_types.size();
+
+    std::vector<viennagrid_element_id> vertex_ids(vertex_count);
+    PointType p(geometric_dimension);
+    for (viennagrid_int i = 0; i != vertex_count; ++i)
+    {
+      for (int d = 0; d != geometric_dimension; ++d)
+        p[d] = chunk.coords[i*geometric_dimension + d];
+      vertex_ids[i] = viennagrid::make_vertex(dst_mesh, p).id().internal();
+    }
+
+    if (cell_count == 0)
+      return;
+
+    std::vector<viennagrid_element_id> cell_vertices( chunk.cell_vertices.size() );
+    for (std::size_t i = 0; i != chunk.cell_vertices.size(); ++i)
+      cell_vertices[i] = vertex_ids[ chunk.cell_vertices[i] ];
+
+    std::set<viennagrid_region_id> used_regions( chunk.cell_regions.begin(), chunk.cell_regions.end() );
+    for (std::set<viennagrid_region_id>::const_iterator it = used_regions.begin(); it != used_regions.end(); ++it)
+      dst_mesh.get_or_create_region(*it);
+
+    // the first region of each cell is assigned in the batch, further regions are added afterwards
+    std::vector<viennagrid_region_id> first_regions(cell_count);
+    bool has_additional_regions = false;
+    for (viennagrid_int i = 0; i != cell_count; ++i)
+    {
+      first_regions[i] = chunk.cell_regions[ chunk.cell_region_offsets[i] ];
+      if (chunk.cell_region_offsets[i+1] - chunk.cell_region_offsets[i] > 1)
+        has_additional_regions = true;
+    }
+
+    std::vector<viennagrid_element_id> cell_ids(cell_count);
+    viennagrid_mesh_element_batch_create( dst_mesh.internal(),
+                                          cell_count, &chunk.cell_types[0],
+                                          &chunk.cell_vertex_offsets[0], &cell_vertices[0],
+                                          &first_regions[0], &cell_ids[0] );
+
+    if (has_additional_regions)
+    {
+      for (viennagrid_int i = 0; i != cell_count; ++i)
+      {
+        for (viennagrid_int j = chunk.cell_region_offsets[i]+1; j < chunk.cell_region_offsets[i+1]; ++j)
+        {
+          ElementType cell( dst_mesh, cell_ids[i] );
+          viennagrid::add( dst_mesh.get_or_create_region(chunk.cell_regions[j]), cell );
         }
       }
     }
@@ -74,15 +426,12 @@ namespace viennamesh
 
     info(1) << "Using region offset: " << std::boolalpha << region_offset << std::endl;
 
-    int merged_count = 0;
+    std::vector<viennagrid::mesh> meshes;
     if (input_mesh.valid())
     {
       int mesh_count = input_mesh.size();
       for (int i = 0; i != mesh_count; ++i)
-      {
-        merge_meshes_impl( input_mesh(i), output_mesh(), (merged_count == 0 ? -1 : tolerance), region_offset );
-        ++merged_count;
-      }
+        meshes.push_back( input_mesh(i) );
     }
 
     int mesh_index = 0;
@@ -96,28 +445,45 @@ namespace viennamesh
 
       int mesh_count = another_input_mesh.size();
       for (int i = 0; i != mesh_count; ++i)
-      {
-        merge_meshes_impl( another_input_mesh(i), output_mesh(), (merged_count == 0 ? -1 : tolerance), region_offset );
-        ++merged_count;
-      }
+        meshes.push_back( another_input_mesh(i) );
 
       ++mesh_index;
     }
 
-//
+    int merged_count = meshes.size();
+    if (merged_count != 0)
+    {
+      int geometric_dimension = viennagrid::geometric_dimension( meshes[0] );
+      for (int i = 1; i != merged_count; ++i)
+      {
+        if (viennagrid::geometric_dimension(meshes[i]) != geometric_dimension)
+        {
+          error(1) << "Dimension mismatch: mesh 0 has geometric dimension " << geometric_dimension
+                   << ", mesh " << i << " has geometric dimension " << viennagrid::geometric_dimension(meshes[i]) << std::endl;
+          return false;
+        }
+      }
 
+      // viennagrid is only accessed serially, welding and concatenation work on the flat chunks
+      std::vector<merge_mesh_chunk> chunks(merged_count);
+      int region_id_offset = 0;
+      for (int i = 0; i != merged_count; ++i)
+      {
+        extract_merge_chunk( meshes[i], geometric_dimension, region_offset ? region_id_offset : 0, chunks[i] );
+        region_id_offset += std::max( static_cast<int>(meshes[i].region_count()), 1 );
+      }
 
+      // like the first mesh copied into the empty output, the vertices within the
+      // first mesh are never welded, those of all other meshes are
+#ifdef VIENNAMESH_WITH_OPENMP
+      #pragma omp parallel for schedule(dynamic)
+#endif
+      for (int i = 1; i < merged_count; ++i)
+        weld_chunk_vertices( chunks[i], geometric_dimension, tolerance );
 
-//     if (input_mesh)
-//       merge_meshes_impl( input_mesh(), output_mesh() );
-//
-//     int index = 0;
-//     input_mesh = get_input<mesh_handle>("mesh[" + lexical_cast<std::string>(index++) + "]");
-//     while (input_mesh)
-//     {
-//       merge_meshes_impl( input_mesh(), output_mesh() );
-//       input_mesh = get_input<mesh_handle>("mesh[" + lexical_cast<std::string>(index++) + "]");
-//     }
+      reduce_merge_chunks( chunks, geometric_dimension, tolerance );
+      make_merged_mesh( chunks[0], geometric_dimension, output_mesh() );
+    }
 
     info(1) << "Merged " << merged_count << " meshes" << std::endl;
 
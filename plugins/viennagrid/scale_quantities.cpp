@@ -13,40 +13,178 @@
 =============================================================================== */
 
 #include "scale_quantities.hpp"
-#include "viennagrid/algorithm/geometric_transform.hpp"
+
+#include <algorithm>
+#include <vector>
 
 namespace viennamesh
 {
+  namespace
+  {
+    // indices of all elements of the given dimension, in mesh order
+    void element_indices(viennagrid::mesh const & mesh, viennagrid_dimension dimension,
+                         std::vector<viennagrid_int> & indices)
+    {
+      typedef viennagrid::result_of::const_element_range<viennagrid::mesh>::type ConstElementRangeType;
+      typedef viennagrid::result_of::iterator<ConstElementRangeType>::type ConstElementIteratorType;
+
+      ConstElementRangeType elements( mesh, dimension );
+      indices.clear();
+      indices.reserve( elements.size() );
+      for (ConstElementIteratorType eit = elements.begin(); eit != elements.end(); ++eit)
+        indices.push_back( (*eit).id().index() );
+    }
+
+    viennagrid_int field_size(viennagrid::quantity_field const & field)
+    {
+      viennagrid_int size;
+      viennagrid_quantity_field_size( field.internal(), &size );
+      return size;
+    }
+
+    // value buffer of a dense quantity field, the values of element i start
+    // at values[i*values_per_quantity]
+    viennagrid_numeric * dense_values(viennagrid::quantity_field const & field)
+    {
+      void * values = 0;
+      viennagrid_quantity_field_value_get( field.internal(), 0, &values );
+      return static_cast<viennagrid_numeric*>(values);
+    }
+
+    // a range of the value buffer of one dense field
+    struct value_chunk
+    {
+      viennagrid_numeric const * src;
+      viennagrid_numeric * dst;
+      long count;
+    };
+
+    // values per chunk, large enough to amortize the scheduling
+    long const values_per_chunk = 1 << 16;
+  }
+
+
   scale_quantities::scale_quantities() {}
   std::string scale_quantities::name() { return "scale_quantities"; }
 
   bool scale_quantities::run(viennamesh::algorithm_handle &)
   {
     mesh_handle input_mesh = get_required_input<mesh_handle>("mesh");
-    quantity_field_handle input_quantity_field = get_input<viennagrid::quantity_field>("quantities");
+    quantity_field_handle input_quantity_field = get_required_input<viennagrid::quantity_field>("quantities");
 
     data_handle<double> scale = get_required_input<double>("scale");
     data_handle<double> translate = get_input<double>("translate");
 
+    viennagrid_numeric scale_value = scale();
+    viennagrid_numeric translate_value = translate.valid() ? translate() : 0.0;
 
-    typedef viennagrid::mesh MeshType;
-    typedef viennagrid::result_of::const_element_range<MeshType>::type ConstElementRangeType;
-    typedef viennagrid::result_of::iterator<ConstElementRangeType>::type ConstElementIteratorType;
+    // the identity leaves all values unchanged, the input is shared
+    if (scale_value == 1.0 && translate_value == 0.0)
+    {
+      set_output( "quantities", input_quantity_field );
+      return true;
+    }
 
-    quantity_field_handle output_quantity_fields = make_data<viennagrid::quantity_field>();
-    output_quantity_fields.resize( input_quantity_field.size() );
+    int field_count = input_quantity_field.size();
 
-    for (viennagrid_int i = 0; i != input_quantity_field.size(); ++i)
+    // input fields referenced by nothing else, e.g. converted ones, are
+    // changed and returned, otherwise new fields are created, which has to
+    // happen outside of parallel regions
+    bool transform_in_place = input_is_unique( "quantities", input_quantity_field );
+    quantity_field_handle output_quantity_fields =
+        transform_in_place ? input_quantity_field : make_data<viennagrid::quantity_field>();
+    if (!transform_in_place)
+      output_quantity_fields.resize( field_count );
+
+    std::vector<viennagrid::quantity_field> sources(field_count);
+    std::vector<viennagrid::quantity_field> fields(field_count);
+    for (int i = 0; i != field_count; ++i)
     {
-      output_quantity_fields(i).init( input_quantity_field(i).topologic_dimension(),
-                                      input_quantity_field(i).values_per_quantity() );
-      output_quantity_fields(i).set_name( input_quantity_field(i).get_name() );
+      sources[i] = input_quantity_field(i);
+      if (!transform_in_place)
+      {
+        output_quantity_fields(i).init( sources[i].topologic_dimension(),
+                                        sources[i].values_per_quantity() );
+        output_quantity_fields(i).set_name( sources[i].get_name() );
+      }
+      fields[i] = output_quantity_fields(i);
+    }
+
+    // the value buffers of all dense fields are split into chunks, which are
+    // transformed concurrently, so a single field uses all threads as well
+    std::vector<value_chunk> chunks;
+    std::vector<int> sparse_fields;
+    for (int i = 0; i != field_count; ++i)
+    {
+      if (sources[i].storage_layout() != VIENNAGRID_QUANTITY_FIELD_STORAGE_DENSE)
+      {
+        sparse_fields.push_back(i);
+        continue;
+      }
+
+      viennagrid_int size = field_size( sources[i] );
+      if (size == 0)
+        continue;
+      if (!transform_in_place)
+        viennagrid_quantity_field_resize( fields[i].internal(), size );
+
+      long value_count = static_cast<long>(size) * sources[i].values_per_quantity();
+      viennagrid_numeric const * src = dense_values( sources[i] );
+      viennagrid_numeric * dst = dense_values( fields[i] );
+      for (long first = 0; first < value_count; first += values_per_chunk)
+      {
+        value_chunk chunk;
+        chunk.src = src + first;
+        chunk.dst = dst + first;
+        chunk.count = std::min(values_per_chunk, value_count - first);
+        chunks.push_back(chunk);
+      }
+    }
+
+    long chunk_count = chunks.size();
+#ifdef VIENNAMESH_WITH_OPENMP
+    #pragma omp parallel for schedule(dynamic, 1)
+#endif
+    for (long c = 0; c < chunk_count; ++c)
+    {
+      value_chunk const & chunk = chunks[c];
+      for (long j = 0; j != chunk.count; ++j)
+        chunk.dst[j] = chunk.src[j] * scale_value + translate_value;
+    }
+
+    // sparse fields have no value buffer and are transformed element by
+    // element, each field by one thread only
+    std::vector<viennagrid_int> indices;
+    std::vector<int> group;
+    viennagrid_dimension cell_dimension = viennagrid::cell_dimension( input_mesh() );
+    for (viennagrid_dimension dimension = 0; dimension <= cell_dimension && !sparse_fields.empty(); ++dimension)
+    {
+      group.clear();
+      for (std::size_t i = 0; i != sparse_fields.size(); ++i)
+      {
+        if (sources[sparse_fields[i]].topologic_dimension() == dimension)
+          group.push_back( sparse_fields[i] );
+      }
+      if (group.empty())
+        continue;
+
+      element_indices( input_mesh(), dimension, indices );
+
+      int group_size = group.size();
+      int element_count = indices.size();
 
-      ConstElementRangeType cells( input_mesh(), input_quantity_field(i).topologic_dimension() );
-      for (ConstElementIteratorType cit = cells.begin(); cit != cells.end(); ++cit)
+#ifdef VIENNAMESH_WITH_OPENMP
+      #pragma omp parallel for
+#endif
+      for (int g = 0; g < group_size; ++g)
       {
-        viennagrid_numeric value = input_quantity_field(i).get(*cit);
-        output_quantity_fields(i).set( *cit, value * scale() + translate() );
+        viennagrid::quantity_field const & src = sources[group[g]];
+        viennagrid::quantity_field & dst = fields[group[g]];
+        for (int j = 0; j != element_count; ++j)
+        {
+          if (src.valid( indices[j] ))
+            dst.set( indices[j], src.get( indices[j] ) * scale_value + translate_value );
+        }
       }
     }
 
@@ -14,8 +14,87 @@
 
 #include "split_mesh.hpp"
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "viennameshpp/simplex_mesh.hpp"
+
 namespace viennamesh
 {
+  // cells of the input mesh in flat arrays, vertices and cells by index
+  struct split_mesh_cells
+  {
+    int geometric_dimension;
+    std::vector<viennagrid_numeric> coords;
+
+    std::vector<viennagrid_element_type> cell_types;
+    std::vector<viennagrid_int> cell_vertex_offsets;
+    std::vector<viennagrid_int> cell_vertices;
+  };
+
+
+  // Builds the mesh of one region from its cells. Vertices are numbered in the
+  // order of their first use, like an element_copy_map does. local_index has
+  // one entry per input vertex, all -1, and is reset before returning.
+  void make_region_mesh(split_mesh_cells const & input,
+                        viennagrid_int const * cells_begin, viennagrid_int const * cells_end,
+                        std::vector<viennagrid_int> & local_index,
+                        viennagrid::mesh const & dst_mesh)
+  {
+    typedef viennagrid::mesh                                        MeshType;
+    typedef viennagrid::result_of::point<MeshType>::type            PointType;
+
+    int geometric_dimension = input.geometric_dimension;
+
+    std::vector<viennagrid_int> used_vertices;
+    std::vector<viennagrid_element_type> cell_types;
+    std::vector<viennagrid_int> cell_vertex_offsets(1, 0);
+    std::vector<viennagrid_element_id> cell_vertices;
+
+    cell_types.reserve( cells_end-cells_begin );
+    cell_vertex_offsets.reserve( cells_end-cells_begin+1 );
+
+    std::vector<viennagrid_element_id> vertex_ids;
+    PointType p(geometric_dimension);
+
+    for (viennagrid_int const * cit = cells_begin; cit != cells_end; ++cit)
+    {
+      viennagrid_int cell = *cit;
+      cell_types.push_back( input.cell_types[cell] );
+
+      for (viennagrid_int i = input.cell_vertex_offsets[cell]; i != input.cell_vertex_offsets[cell+1]; ++i)
+      {
+        viennagrid_int vertex = input.cell_vertices[i];
+        if (local_index[vertex] == -1)
+        {
+          local_index[vertex] = used_vertices.size();
+          used_vertices.push_back(vertex);
+
+          for (int d = 0; d != geometric_dimension; ++d)
+            p[d] = input.coords[vertex*geometric_dimension + d];
+          vertex_ids.push_back( viennagrid::make_vertex(dst_mesh, p).id().internal() );
+        }
+
+        cell_vertices.push_back( vertex_ids[local_index[vertex]] );
+      }
+      cell_vertex_offsets.push_back( cell_vertices.size() );
+    }
+
+    for (std::size_t i = 0; i != used_vertices.size(); ++i)
+      local_index[ used_vertices[i] ] = -1;
+
+    if (cell_types.empty())
+      return;
+
+    viennagrid_mesh_element_batch_create( dst_mesh.internal(),
+                                          cell_types.size(), &cell_types[0],
+                                          &cell_vertex_offsets[0], &cell_vertices[0],
+                                          NULL, NULL );
+  }
+
+
+
   split_mesh::split_mesh() {}
   std::string split_mesh::name() { return "split_mesh"; }
 
@@ -36,16 +115,131 @@ namespace viennamesh
     }
     else
     {
-      int region_index = 0;
-      for (RegionRangeIterator rit = regions.begin(); rit != regions.end(); ++rit, ++region_index)
+      typedef viennagrid::result_of::element<MeshType>::type                  ElementType;
+
+      typedef viennagrid::result_of::const_cell_range<MeshType>::type         ConstCellRangeType;
+      typedef viennagrid::result_of::iterator<ConstCellRangeType>::type       ConstCellIteratorType;
+
+      typedef viennagrid::result_of::const_element_range<ElementType>::type   ConstBoundaryRangeType;
+      typedef viennagrid::result_of::iterator<ConstBoundaryRangeType>::type   ConstBoundaryIteratorType;
+
+      typedef viennagrid::result_of::region_range<ElementType>::type          CellRegionRangeType;
+      typedef viennagrid::result_of::iterator<CellRegionRangeType>::type      CellRegionRangeIterator;
+
+      // output index of each region by region id
+      int region_count = regions.size();
+      viennagrid_region_id max_region_id = 0;
+      for (RegionRangeIterator rit = regions.begin(); rit != regions.end(); ++rit)
+        max_region_id = std::max( max_region_id, (*rit).id() );
+
+      std::vector<int> region_index( max_region_id+1, -1 );
+      int region_index_count = 0;
+      for (RegionRangeIterator rit = regions.begin(); rit != regions.end(); ++rit)
+        region_index[ (*rit).id() ] = region_index_count++;
+
+
+      // one pass over the input: flat vertex and cell arrays, and the cells of
+      // each region bucketed by region index
+      split_mesh_cells input;
+      input.geometric_dimension = viennagrid::geometric_dimension( input_mesh() );
+
+      read_vertex_coords( input_mesh(), input.coords );
+
+      ConstCellRangeType cells( input_mesh() );
+      input.cell_types.resize( cells.size() );
+      input.cell_vertex_offsets.resize( cells.size()+1, 0 );
+
+      std::vector<viennagrid_int> cell_region_offsets( cells.size()+1, 0 );
+      std::vector<int> cell_regions;
+      std::vector<viennagrid_int> region_offsets( region_count+1, 0 );
+
+      viennagrid_int cell_index = 0;
+      for (ConstCellIteratorType cit = cells.begin(); cit != cells.end(); ++cit, ++cell_index)
+      {
+        input.cell_types[cell_index] = (*cit).tag().internal();
+
+        ConstBoundaryRangeType cell_vertices(*cit, 0);
+        for (ConstBoundaryIteratorType vit = cell_vertices.begin(); vit != cell_vertices.end(); ++vit)
+          input.cell_vertices.push_back( (*vit).id().index() );
+        input.cell_vertex_offsets[cell_index+1] = input.cell_vertices.size();
+
+        CellRegionRangeType cell_region_range(*cit);
+        for (CellRegionRangeIterator rit = cell_region_range.begin(); rit != cell_region_range.end(); ++rit)
+        {
+          int index = region_index[ (*rit).id() ];
+          cell_regions.push_back(index);
+          ++region_offsets[index+1];
+        }
+        cell_region_offsets[cell_index+1] = cell_regions.size();
+      }
+
+      for (int i = 0; i != region_count; ++i)
+        region_offsets[i+1] += region_offsets[i];
+
+      std::vector<viennagrid_int> region_cells( region_offsets[region_count] );
       {
-        mesh_handle output_mesh = make_data<mesh_handle>();
-        viennagrid::result_of::element_copy_map<>::type copy_map( output_mesh(), false );
-        viennagrid::copy(copy_map, *rit, output_mesh(), viennagrid::true_functor());
-        set_output( "mesh[" + lexical_cast<std::string>(region_index) + "]", output_mesh );
+        std::vector<viennagrid_int> region_fill( region_offsets.begin(), region_offsets.end()-1 );
+        for (viennagrid_int cell = 0; cell != cell_index; ++cell)
+          for (viennagrid_int i = cell_region_offsets[cell]; i != cell_region_offsets[cell+1]; ++i)
+            region_cells[ region_fill[cell_regions[i]]++ ] = cell;
       }
 
-      info(1) << "Split mesh into " << region_index << " meshes" << std::endl;
+
+      // the output data has to be created by the context, which is not thread
+      // safe, the meshes themselves are independent and built concurrently
+      std::vector<mesh_handle> output_meshes;
+      std::vector<viennagrid::mesh> meshes;
+      for (int i = 0; i != region_count; ++i)
+      {
+        output_meshes.push_back( make_data<mesh_handle>() );
+        meshes.push_back( output_meshes.back()() );
+      }
+
+      viennagrid_int const * region_cells_begin = region_cells.empty() ? NULL : &region_cells[0];
+
+      bool failed = false;
+      std::string failure_message;
+
+#ifdef VIENNAMESH_WITH_OPENMP
+      #pragma omp parallel
+#endif
+      {
+        std::vector<viennagrid_int> local_index( input.coords.size() / input.geometric_dimension, -1 );
+
+#ifdef VIENNAMESH_WITH_OPENMP
+        #pragma omp for schedule(dynamic)
+#endif
+        for (int i = 0; i < region_count; ++i)
+        {
+          try
+          {
+            make_region_mesh( input,
+                              region_cells_begin + region_offsets[i], region_cells_begin + region_offsets[i+1],
+                              local_index, meshes[i] );
+          }
+          catch (std::exception const & ex)
+          {
+#ifdef VIENNAMESH_WITH_OPENMP
+            #pragma omp critical
+#endif
+            {
+              failed = true;
+              failure_message = ex.what();
+            }
+          }
+        }
+      }
+
+      if (failed)
+      {
+        error(1) << "Creating a region mesh failed: " << failure_message << std::endl;
+        return false;
+      }
+
+      for (int i = 0; i != region_count; ++i)
+        set_output( "mesh[" + lexical_cast<std::string>(i) + "]", output_meshes[i] );
+
+      info(1) << "Split mesh into " << region_count << " meshes" << std::endl;
     }
 
     return true;
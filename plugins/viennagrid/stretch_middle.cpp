@@ -13,6 +13,8 @@
 =============================================================================== */
 
 #include "stretch_middle.hpp"
+
+#include <cmath>
 #include "viennagrid/algorithm/geometric_transform.hpp"
 
 namespace viennamesh
@@ -27,30 +29,34 @@ namespace viennamesh
     data_handle<double> stretch = get_required_input<double>("stretch");
     data_handle<double> middle_tolerance = get_required_input<double>("middle_tolerance");
 
-    mesh_handle output_mesh = make_data<mesh_handle>();
+    // no stretch leaves all coordinates unchanged, the input is shared
+    if (stretch() == 0.0)
+    {
+      set_output( "mesh", input_mesh );
+      return true;
+    }
 
-    if (output_mesh != input_mesh)
-      viennagrid::copy( input_mesh(), output_mesh() );
+    mesh_handle output_mesh = make_coordinate_output( "mesh", input_mesh );
 
-    typedef viennagrid::mesh MeshType;
-    typedef viennagrid::result_of::point<MeshType>::type PointType;
-    typedef viennagrid::result_of::const_element_range<MeshType>::type ConstElementRangeType;
-    typedef viennagrid::result_of::iterator<ConstElementRangeType>::type ConstElementIteratorType;
+    int geometric_dimension = viennagrid::geometric_dimension( output_mesh() );
+    double stretch_value = stretch();
+    double tolerance = middle_tolerance();
 
-    ConstElementRangeType vertices( output_mesh(), 0 );
-    for (ConstElementIteratorType vit = vertices.begin(); vit != vertices.end(); ++vit)
-    {
-      PointType pt = viennagrid::get_point(*vit);
+    viennagrid_numeric * coords;
+    viennagrid_mesh_vertex_coords_pointer( output_mesh().internal(), &coords );
 
-      if (std::abs(pt[0]) >= middle_tolerance())
-      {
-        if (pt[0] < 0)
-          pt[0] -= stretch();
-        else
-          pt[0] += stretch();
-      }
+    viennagrid_int vertex_count;
+    viennagrid_mesh_element_count( output_mesh().internal(), 0, &vertex_count );
 
-      viennagrid::set_point(*vit, pt);
+    // only the x coordinate is stretched, outside of the middle
+#ifdef VIENNAMESH_WITH_OPENMP
+    #pragma omp parallel for
+#endif
+    for (int i = 0; i < vertex_count; ++i)
+    {
+      viennagrid_numeric & x = coords[i*geometric_dimension];
+      if (std::abs(x) >= tolerance)
+        x += (x < 0) ? -stretch_value : stretch_value;
     }
 
     set_output( "mesh", output_mesh );
@@ -13,11 +13,247 @@
 =============================================================================== */
 
 #include "uniform_refine.hpp"
+
+#include <algorithm>
+#include <vector>
+
 #include "viennagrid/viennagrid.hpp"
 #include "viennagrid/algorithm/refine.hpp"
 
+#include "viennameshpp/parallel.hpp"
+#include "viennameshpp/simplex_mesh.hpp"
+
 namespace viennamesh
 {
+  namespace
+  {
+    // values of one scalar quantity field by vertex or cell index
+    struct refine_field
+    {
+      viennagrid::quantity_field source;
+      std::vector<viennagrid_numeric> values;
+      std::vector<char> valid;
+    };
+
+    // triangle or tetrahedron mesh with its refined quantity fields
+    struct refine_mesh : simplex_mesh
+    {
+      std::vector<refine_field> vertex_fields;
+      std::vector<refine_field> cell_fields;
+    };
+
+
+    // the children of a cell by local vertex, where the midpoint of local edge
+    // i of triangle_edges or tetrahedron_edges is local vertex vertices_per_cell + i
+    int const triangle_children[4][3] = { {0,3,4}, {3,1,5}, {4,5,2}, {3,5,4} };
+
+    int const tetrahedron_corner_children[4][4] = { {0,4,5,6}, {4,1,7,8}, {5,7,2,9}, {6,8,9,3} };
+    // the midpoints of opposite edges span the three diagonals of the inner octahedron
+    int const tetrahedron_diagonals[3][2] = { {4,9}, {5,8}, {6,7} };
+
+
+    double squared_distance(viennagrid_numeric const * p, viennagrid_numeric const * q, int geometric_dimension)
+    {
+      double result = 0;
+      for (int d = 0; d != geometric_dimension; ++d)
+        result += (p[d]-q[d])*(p[d]-q[d]);
+      return result;
+    }
+
+
+    // Refines every cell into 4 triangles or 8 tetrahedra. All edges are
+    // numbered up front by sorting the edges of all cells, the midpoint of edge
+    // i becomes vertex vertex_count + i. Children inherit the regions and cell
+    // values of their parent, midpoints the mean of the edge vertex values.
+    void refine_uniformly(refine_mesh & mesh)
+    {
+      int geometric_dimension = mesh.geometric_dimension;
+      int vertices_per_cell = mesh.vertices_per_cell;
+      int edges_per_cell = (vertices_per_cell == 3) ? 3 : 6;
+      int children_per_cell = (vertices_per_cell == 3) ? 4 : 8;
+      int const (*cell_edges_local)[2] = (vertices_per_cell == 3) ? triangle_edges : tetrahedron_edges;
+
+      viennagrid_int vertex_count = mesh.vertex_count();
+      viennagrid_int cell_count = mesh.cell_count();
+      viennagrid_int slot_count = cell_count * edges_per_cell;
+
+      // number the edges, cell_edges holds the edge index of each local edge
+      std::vector<edge_slot> slots(slot_count);
+#ifdef VIENNAMESH_WITH_OPENMP
+      #pragma omp parallel for
+#endif
+      for (viennagrid_int cell = 0; cell < cell_count; ++cell)
+      {
+        viennagrid_int const * vertices = &mesh.cell_vertices[cell*vertices_per_cell];
+        for (int i = 0; i != edges_per_cell; ++i)
+          slots[cell*edges_per_cell + i] = edge_slot( vertices[cell_edges_local[i][0]],
+                                                      vertices[cell_edges_local[i][1]],
+                                                      cell*edges_per_cell + i );
+      }
+
+      std::vector<viennagrid_int> cell_edges(slot_count);
+      std::vector<viennagrid_int> edge_vertices;
+      number_edges( slots, cell_edges, edge_vertices );
+
+      viennagrid_int edge_count = edge_vertices.size()/2;
+
+
+      // midpoints and their vertex values
+      mesh.coords.resize( (vertex_count + edge_count) * geometric_dimension );
+#ifdef VIENNAMESH_WITH_OPENMP
+      #pragma omp parallel for
+#endif
+      for (viennagrid_int edge = 0; edge < edge_count; ++edge)
+      {
+        viennagrid_numeric const * p0 = &mesh.coords[ edge_vertices[2*edge] * geometric_dimension ];
+        viennagrid_numeric const * p1 = &mesh.coords[ edge_vertices[2*edge+1] * geometric_dimension ];
+        viennagrid_numeric * midpoint = &mesh.coords[ (vertex_count + edge) * geometric_dimension ];
+        for (int d = 0; d != geometric_dimension; ++d)
+          midpoint[d] = (p0[d] + p1[d]) / 2;
+      }
+
+      for (std::size_t f = 0; f != mesh.vertex_fields.size(); ++f)
+      {
+        refine_field & field = mesh.vertex_fields[f];
+        field.values.resize( vertex_count + edge_count );
+        field.valid.resize( vertex_count + edge_count );
+
+#ifdef VIENNAMESH_WITH_OPENMP
+        #pragma omp parallel for
+#endif
+        for (viennagrid_int edge = 0; edge < edge_count; ++edge)
+        {
+          viennagrid_int v0 = edge_vertices[2*edge];
+          viennagrid_int v1 = edge_vertices[2*edge+1];
+          field.valid[vertex_count + edge] = field.valid[v0] && field.valid[v1];
+          field.values[vertex_count + edge] = (field.values[v0] + field.values[v1]) / 2;
+        }
+      }
+
+
+      // children, their regions and cell values
+      std::vector<viennagrid_int> child_vertices( cell_count * children_per_cell * vertices_per_cell );
+      std::vector<viennagrid_int> child_region_offsets( cell_count * children_per_cell + 1 );
+      std::vector<viennagrid_region_id> child_regions( mesh.cell_regions.size() * children_per_cell );
+
+#ifdef VIENNAMESH_WITH_OPENMP
+      #pragma omp parallel for
+#endif
+      for (viennagrid_int cell = 0; cell < cell_count; ++cell)
+      {
+        viennagrid_int local[10];
+        for (int i = 0; i != vertices_per_cell; ++i)
+          local[i] = mesh.cell_vertices[cell*vertices_per_cell + i];
+        for (int i = 0; i != edges_per_cell; ++i)
+          local[vertices_per_cell + i] = vertex_count + cell_edges[cell*edges_per_cell + i];
+
+        viennagrid_int * children = &child_vertices[cell * children_per_cell * vertices_per_cell];
+        if (vertices_per_cell == 3)
+        {
+          for (int c = 0; c != 4; ++c)
+            for (int i = 0; i != 3; ++i)
+              *children++ = local[ triangle_children[c][i] ];
+        }
+        else
+        {
+          for (int c = 0; c != 4; ++c)
+            for (int i = 0; i != 4; ++i)
+              *children++ = local[ tetrahedron_corner_children[c][i] ];
+
+          // the inner octahedron is split along its shortest diagonal
+          int diagonal = 0;
+          double shortest = -1;
+          for (int k = 0; k != 3; ++k)
+          {
+            double length = squared_distance( &mesh.coords[ local[tetrahedron_diagonals[k][0]] * geometric_dimension ],
+                                              &mesh.coords[ local[tetrahedron_diagonals[k][1]] * geometric_dimension ],
+                                              geometric_dimension );
+            if (shortest < 0 || length < shortest)
+            {
+              shortest = length;
+              diagonal = k;
+            }
+          }
+
+          int const * a = tetrahedron_diagonals[(diagonal+1)%3];
+          int const * b = tetrahedron_diagonals[(diagonal+2)%3];
+          int const ring[4] = { a[0], b[0], a[1], b[1] };
+          for (int c = 0; c != 4; ++c)
+          {
+            *children++ = local[ tetrahedron_diagonals[diagonal][0] ];
+            *children++ = local[ tetrahedron_diagonals[diagonal][1] ];
+            *children++ = local[ ring[c] ];
+            *children++ = local[ ring[(c+1)%4] ];
+          }
+        }
+
+        viennagrid_int region_begin = mesh.cell_region_offsets[cell];
+        viennagrid_int region_count = mesh.cell_region_offsets[cell+1] - region_begin;
+        for (int c = 0; c != children_per_cell; ++c)
+        {
+          viennagrid_int child_region_begin = region_begin*children_per_cell + c*region_count;
+          child_region_offsets[cell*children_per_cell + c] = child_region_begin;
+          for (viennagrid_int i = 0; i != region_count; ++i)
+            child_regions[child_region_begin + i] = mesh.cell_regions[region_begin + i];
+        }
+      }
+      child_region_offsets[cell_count * children_per_cell] = child_regions.size();
+
+      for (std::size_t f = 0; f != mesh.cell_fields.size(); ++f)
+      {
+        refine_field & field = mesh.cell_fields[f];
+        std::vector<viennagrid_numeric> values( cell_count * children_per_cell );
+        std::vector<char> valid( cell_count * children_per_cell );
+
+#ifdef VIENNAMESH_WITH_OPENMP
+        #pragma omp parallel for
+#endif
+        for (viennagrid_int child = 0; child < cell_count * children_per_cell; ++child)
+        {
+          values[child] = field.values[child / children_per_cell];
+          valid[child] = field.valid[child / children_per_cell];
+        }
+
+        field.values.swap(values);
+        field.valid.swap(valid);
+      }
+
+      mesh.cell_vertices.swap(child_vertices);
+      mesh.cell_region_offsets.swap(child_region_offsets);
+      mesh.cell_regions.swap(child_regions);
+    }
+
+
+    void read_refine_field(viennagrid::quantity_field const & source, viennagrid_int count, refine_field & field)
+    {
+      field.source = source;
+      field.values.resize(count);
+      field.valid.resize(count);
+      for (viennagrid_int i = 0; i != count; ++i)
+      {
+        field.valid[i] = source.valid(i);
+        field.values[i] = field.valid[i] ? source.get(i) : 0.0;
+      }
+    }
+
+
+    viennagrid::quantity_field make_refined_field(refine_field const & field)
+    {
+      viennagrid::quantity_field result;
+      result.init( field.source.topologic_dimension(), 1 );
+      result.set_name( field.source.get_name() );
+
+      for (std::size_t i = 0; i != field.values.size(); ++i)
+      {
+        if (field.valid[i])
+          result.set( static_cast<viennagrid_int>(i), field.values[i] );
+      }
+
+      return result;
+    }
+  }
+
+
 
   uniform_refine::uniform_refine() {}
   std::string uniform_refine::name() { return "uniform_refine"; }
@@ -29,15 +265,93 @@ namespace viennamesh
     if (!input_mesh.valid())
       return false;
 
+    quantity_field_handle input_quantity_fields = get_input<viennagrid::quantity_field>("quantities");
+
+    int levels = 1;
+    if ( get_input<int>("levels").valid() )
+      levels = get_input<int>("levels")();
+    if (levels < 0)
+    {
+      error(1) << "Refinement level count " << levels << " is negative" << std::endl;
+      return false;
+    }
+
     mesh_handle output_mesh = make_data<mesh_handle>();
 
     if (output_mesh == input_mesh)
       return false;
 
-    viennagrid::cell_refine_uniformly(input_mesh(), output_mesh());
+    // triangle and tetrahedron meshes are refined in flat arrays, all levels
+    // before the output mesh is built
+    refine_mesh mesh;
+    if ( !read_simplex_mesh(input_mesh(), viennagrid::cell_dimension(input_mesh()), mesh) ||
+         mesh.vertices_per_cell == 2 )
+    {
+      if (input_quantity_fields.valid())
+        info(1) << "Mesh has no triangle or tetrahedron cells, quantities are not refined" << std::endl;
+
+      viennagrid::mesh current = input_mesh();
+      for (int level = 0; level != levels; ++level)
+      {
+        viennagrid::mesh refined;
+        viennagrid::cell_refine_uniformly(current, refined);
+        current = refined;
+      }
+      viennagrid::copy( current, output_mesh() );
+
+      set_output( "mesh", output_mesh );
+      return true;
+    }
 
+    viennagrid_dimension cell_dimension = viennagrid::cell_dimension( input_mesh() );
+    if (input_quantity_fields.valid())
+    {
+      for (int i = 0; i != input_quantity_fields.size(); ++i)
+      {
+        viennagrid::quantity_field field = input_quantity_fields(i);
+        if (field.values_per_quantity() != 1 ||
+            (field.topologic_dimension() != 0 && field.topologic_dimension() != cell_dimension))
+        {
+          info(1) << "Quantity field \"" << field.get_name() << "\" is not a scalar field on vertices or cells -> skipping" << std::endl;
+          continue;
+        }
+
+        if (field.topologic_dimension() == 0)
+        {
+          mesh.vertex_fields.push_back( refine_field() );
+          read_refine_field( field, mesh.vertex_count(), mesh.vertex_fields.back() );
+        }
+        else
+        {
+          mesh.cell_fields.push_back( refine_field() );
+          read_refine_field( field, mesh.cell_count(), mesh.cell_fields.back() );
+        }
+      }
+    }
+
+    for (int level = 0; level != levels; ++level)
+      refine_uniformly(mesh);
+
+    copy_regions( input_mesh(), output_mesh() );
+    make_simplex_mesh( mesh, output_mesh() );
     set_output( "mesh", output_mesh );
 
+    if (input_quantity_fields.valid())
+    {
+      std::vector<refine_field const *> fields;
+      for (std::size_t i = 0; i != mesh.vertex_fields.size(); ++i)
+        fields.push_back( &mesh.vertex_fields[i] );
+      for (std::size_t i = 0; i != mesh.cell_fields.size(); ++i)
+        fields.push_back( &mesh.cell_fields[i] );
+
+      quantity_field_handle output_quantity_fields = make_data<viennagrid::quantity_field>();
+      output_quantity_fields.resize( fields.size() );
+      for (std::size_t i = 0; i != fields.size(); ++i)
+        output_quantity_fields.set( i, make_refined_field(*fields[i]) );
+
+      set_output( "quantities", output_quantity_fields );
+    }
+
     return true;
   }
 
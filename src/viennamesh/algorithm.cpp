@@ -152,6 +152,19 @@ viennamesh_data_wrapper viennamesh_algorithm_wrapper_t::get_input(std::string co
 
 
 
+// data obtained with get_input is unique if the single reference of the caller
+// is the only reference to it, e.g. after a type conversion. Data held by the
+// input parameter itself is never unique, it is used again on the next run.
+bool viennamesh_algorithm_wrapper_t::input_is_unique(std::string const & name, viennamesh_data_wrapper data)
+{
+  InputMapType::const_iterator it = inputs.find(name);
+  if (it != inputs.end() && it->second.holds(data))
+    return false;
+
+  return data->use_count() == 1;
+}
+
+
 
 void viennamesh_algorithm_wrapper_t::clear_outputs()
 {
@@ -18,6 +18,7 @@ public:
   void link(viennamesh_algorithm_wrapper source_algorithm_, std::string source_name_);
 
   viennamesh_data_wrapper unpack() const;
+  bool holds(viennamesh_data_wrapper data) const { return input == data; }
 
 private:
   viennamesh_data_wrapper input;
@@ -57,6 +58,7 @@ public:
   viennamesh_data_wrapper get_input(std::string const & name);
   viennamesh_data_wrapper get_input(std::string const & name,
                                     std::string const & type_name);
+  bool input_is_unique(std::string const & name, viennamesh_data_wrapper data);
 
   void clear_outputs();
   void set_output(std::string const & name, viennamesh_data_wrapper output);
@@ -47,6 +47,7 @@ public:
 
   viennamesh::data_template data_template() { return data_template_;}
 
+  int use_count() const { return use_count_; }
   void retain() { ++use_count_; }
   bool release()
   {
@@ -838,6 +838,27 @@ viennamesh_error viennamesh_algorithm_get_input_with_type(viennamesh_algorithm_w
 }
 
 
+viennamesh_error viennamesh_algorithm_input_is_unique(viennamesh_algorithm_wrapper algorithm,
+                                                      const char * name,
+                                                      viennamesh_data_wrapper data,
+                                                      int * is_unique)
+{
+  if (!algorithm || !name || !data || !is_unique)
+    return VIENNAMESH_ERROR_INVALID_ARGUMENT;
+
+  try
+  {
+    *is_unique = algorithm->input_is_unique(name, data) ? 1 : 0;
+  }
+  catch (...)
+  {
+    return viennamesh::handle_error(algorithm->context());
+  }
+
+  return VIENNAMESH_SUCCESS;
+}
+
+
 
 viennamesh_error viennamesh_algorithm_clear_outputs(viennamesh_algorithm_wrapper algorithm)
 {
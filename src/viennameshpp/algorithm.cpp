@@ -77,6 +77,13 @@ namespace viennamesh
     return abstract_data_handle(data_);
   }
 
+  bool algorithm_handle::input_is_unique(std::string const & name, abstract_data_handle const & data)
+  {
+    int is_unique;
+    handle_error(viennamesh_algorithm_input_is_unique(algorithm, name.c_str(), data.internal(), &is_unique), algorithm);
+    return is_unique != 0;
+  }
+
   abstract_data_handle algorithm_handle::get_required_input(std::string const & name)
   {
     abstract_data_handle result = get_input(name);
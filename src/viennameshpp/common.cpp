@@ -1,5 +1,9 @@
 #include "viennameshpp/common.hpp"
 
+#include <vector>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/trim.hpp>
+
 namespace viennamesh
 {
   std::string extract_filename( std::string const & path )
@@ -21,4 +25,19 @@ namespace viennamesh
       return "";
     return path.substr(0, pos+1);
   }
+
+  std::set<std::string> split_names( std::string const & names )
+  {
+    std::vector<std::string> parts;
+    boost::algorithm::split(parts, names, boost::is_any_of(","));
+
+    std::set<std::string> result;
+    for (std::size_t i = 0; i != parts.size(); ++i)
+    {
+      boost::algorithm::trim(parts[i]);
+      if (!parts[i].empty())
+        result.insert( parts[i] );
+    }
+    return result;
+  }
 }